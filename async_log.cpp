@@ -0,0 +1,435 @@
+#include "async_log.h"
+#include "binary_log.h"
+#include "stringfmt.h"
+#include "util.h"
+#include "platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// length of a record that only fills the space up to the end of the ring
+static const u32 Pad_Record    = 0xffffffff;
+// set in the length of binary_log.h records
+static const u32 Binary_Record = 0x80000000;
+
+// [u32 length][text or binary record] padded to 8 bytes, records never wrap around the end of the ring
+struct Log_Ring {
+    alignas(64) std::atomic<u64> write_pos;
+    u64                          cached_read_pos; // producer side copy, refreshed only when the ring looks full
+
+    alignas(64) std::atomic<u64> read_pos;
+
+    alignas(64) u8              *data;
+    u64                          size;
+    std::atomic<u64>             dropped;
+    std::atomic<bool>            in_use;
+    Log_Ring                    *next;
+};
+
+struct Async_Logger {
+    Async_Log_Config        config;
+    std::atomic<bool>       running;
+    std::atomic<bool>       wake_pending;
+    std::atomic<Log_Ring *> rings;
+    std::thread             writer;
+    std::thread::id         writer_id;
+
+    std::mutex              mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    bool                    shutting_down;
+    bool                    writer_exited;
+    bool                    exit_hook;
+    u64                     flush_requested;
+    u64                     flush_done;
+
+    FILE                   *file;
+    FILE                   *binary_file;
+    std::string             batch;
+    std::string             binary_batch;
+    std::string             format_entries;
+    u32                     formats_written;
+
+    std::atomic<u64>        messages;
+    std::atomic<u64>        bytes;
+    std::atomic<u64>        dropped;
+    std::atomic<u64>        batches;
+};
+
+// rings are never freed, a thread that exits gives its ring back and the next new thread takes it over
+struct Log_Ring_Owner {
+    Log_Ring *ring = NULL;
+
+    ~Log_Ring_Owner() {
+        if (ring) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static Async_Logger                 logger;
+static thread_local Log_Ring_Owner ring_owner;
+
+static u64 record_size(u64 length) {
+    return (sizeof(u32) + length + 7) & ~u64(7);
+}
+
+static Log_Ring *acquire_ring() {
+    for (Log_Ring *ring = logger.rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        bool expected = false;
+
+        if (ring->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            ring->cached_read_pos = ring->read_pos.load(std::memory_order_acquire);
+            return ring;
+        }
+    }
+
+    u64 size = 4096;
+    while (size < logger.config.ring_size) {
+        size *= 2;
+    }
+
+    Log_Ring *ring        = new Log_Ring();
+    ring->data            = new u8[size];
+    ring->size            = size;
+    ring->cached_read_pos = 0;
+    ring->write_pos.store(0, std::memory_order_relaxed);
+    ring->read_pos.store(0, std::memory_order_relaxed);
+    ring->dropped.store(0, std::memory_order_relaxed);
+    ring->in_use.store(true, std::memory_order_relaxed);
+
+    ring->next = logger.rings.load(std::memory_order_relaxed);
+    while (!logger.rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    return ring;
+}
+
+static void wake_writer() {
+    // only the first producer after the writer went to sleep pays for the lock
+    if (!logger.wake_pending.exchange(true)) {
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        logger.wake.notify_one();
+    }
+}
+
+static bool write_record(const void *data, u64 length, u32 flags) {
+    if (!logger.running.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    Log_Ring *ring = ring_owner.ring;
+    if (!ring) {
+        ring = ring_owner.ring = acquire_ring();
+    }
+
+    // a single message never takes more than half of the ring, binary records can't be cut
+    if (length > ring->size / 2 - sizeof(u32)) {
+        if (flags & Binary_Record) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        length = ring->size / 2 - sizeof(u32);
+    }
+
+    u64 need   = record_size(length);
+    u64 pos    = ring->write_pos.load(std::memory_order_relaxed);
+    u64 offset = pos & (ring->size - 1);
+    u64 pad    = ring->size - offset < need ? ring->size - offset : 0;
+
+    while (pos + pad + need - ring->cached_read_pos > ring->size) {
+        ring->cached_read_pos = ring->read_pos.load(std::memory_order_acquire);
+        if (pos + pad + need - ring->cached_read_pos <= ring->size) {
+            break;
+        }
+
+        wake_writer();
+
+        if (logger.config.full_policy == Log_Full_Drop) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (!logger.running.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    if (pad) {
+        *(u32 *)(ring->data + offset) = Pad_Record;
+        pos += pad;
+        offset = 0;
+    }
+
+    *(u32 *)(ring->data + offset) = u32(length) | flags;
+    memcpy(ring->data + offset + sizeof(u32), data, length);
+
+    u64 used_before = pos - ring->cached_read_pos;
+    ring->write_pos.store(pos + need, std::memory_order_release);
+
+    if (logger.config.flush_policy == Log_Flush_Every_Write) {
+        async_log_flush();
+    } else if (used_before <= ring->size / 2 && used_before + need > ring->size / 2) {
+        // don't wait for the interval when the ring is filling up
+        wake_writer();
+    }
+
+    return true;
+}
+
+bool async_log_write(const char *text, u64 length) {
+    return write_record(text, length, 0);
+}
+
+bool async_log_write_binary(const u8 *record, u64 size) {
+    return write_record(record, size, Binary_Record);
+}
+
+bool async_log_binary() {
+    return logger.running.load(std::memory_order_acquire) && logger.config.binary_log;
+}
+
+static void drain_rings() {
+    std::string &batch   = logger.batch;
+    u64          dropped = 0;
+
+    batch.clear();
+    logger.binary_batch.clear();
+
+    for (Log_Ring *ring = logger.rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        u64 pos = ring->read_pos.load(std::memory_order_relaxed);
+        u64 end = ring->write_pos.load(std::memory_order_acquire);
+
+        while (pos < end) {
+            u64 offset = pos & (ring->size - 1);
+            u32 length = *(u32 *)(ring->data + offset);
+
+            if (length == Pad_Record) {
+                pos += ring->size - offset;
+                continue;
+            }
+
+            const u8 *record = ring->data + offset + sizeof(u32);
+
+            if (length & Binary_Record) {
+                length &= ~Binary_Record;
+
+                if (logger.binary_file) {
+                    logger.binary_batch.append((const char *)&length, sizeof(length));
+                    logger.binary_batch.append((const char *)record, length);
+                } else {
+                    log_decode_record(record, length, batch);
+                }
+            } else {
+                batch.append((const char *)record, length);
+            }
+
+            pos += record_size(length);
+            logger.messages.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ring->read_pos.store(pos, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (dropped) {
+        format_append(batch, "[async_log] dropped /% messages, ring full\n", dropped);
+        logger.dropped.fetch_add(dropped, std::memory_order_relaxed);
+    }
+
+    if (!logger.binary_batch.empty()) {
+        // every format used by the batch was registered before its record was written
+        logger.format_entries.clear();
+        log_append_format_entries(logger.format_entries, logger.formats_written);
+
+        fwrite(logger.format_entries.data(), 1, logger.format_entries.size(), logger.binary_file);
+        fwrite(logger.binary_batch.data(), 1, logger.binary_batch.size(), logger.binary_file);
+        logger.bytes.fetch_add(logger.binary_batch.size(), std::memory_order_relaxed);
+    }
+
+    if (batch.empty()) {
+        return;
+    }
+
+    if (logger.file) {
+        fwrite(batch.data(), 1, batch.size(), logger.file);
+    }
+
+    logger.config.sink(batch.c_str(), batch.size());
+    logger.bytes.fetch_add(batch.size(), std::memory_order_relaxed);
+    logger.batches.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void writer_entrypoint() {
+    using Clock = std::chrono::steady_clock;
+
+    platform_set_thread_name("async_log");
+
+    auto interval   = std::chrono::milliseconds(logger.config.flush_interval_ms);
+    auto last_flush = Clock::now();
+
+    while (true) {
+        u64  ticket;
+        bool shutting_down;
+
+        {
+            std::unique_lock<std::mutex> lock(logger.mutex);
+
+            logger.wake.wait_for(lock, interval, [] {
+                return logger.wake_pending.load() || logger.flush_requested != logger.flush_done || logger.shutting_down;
+            });
+
+            logger.wake_pending.store(false);
+            ticket        = logger.flush_requested;
+            shutting_down = logger.shutting_down;
+        }
+
+        drain_rings();
+
+        auto now   = Clock::now();
+        bool flush = logger.config.flush_policy != Log_Flush_Interval || ticket != logger.flush_done || shutting_down ||
+                     now - last_flush >= interval;
+
+        if (flush) {
+            if (logger.file) {
+                fflush(logger.file);
+            }
+            if (logger.binary_file) {
+                fflush(logger.binary_file);
+            }
+            last_flush = now;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(logger.mutex);
+            logger.flush_done = ticket;
+        }
+        logger.flushed.notify_all();
+
+        if (shutting_down) {
+            break;
+        }
+    }
+}
+
+// runs before the statics are destroyed, a joinable writer would terminate the process there
+static void shutdown_at_exit() {
+    // exit from inside the sink, the writer can't wait for itself
+    if (std::this_thread::get_id() == logger.writer_id) {
+        logger.writer.detach();
+        return;
+    }
+
+    async_log_shutdown();
+}
+
+void async_log_init(const Async_Log_Config &config) {
+    async_log_shutdown();
+
+    if (!logger.exit_hook) {
+        logger.exit_hook = true;
+        std::atexit(shutdown_at_exit);
+    }
+
+    logger.config = config;
+    if (!logger.config.sink) {
+        logger.config.sink = ReportOutput;
+    }
+
+    logger.file = NULL;
+    if (config.file_name) {
+        logger.file = fopen(config.file_name, "w");
+        if (!logger.file) {
+            report("async_log: can't open %s\n", config.file_name);
+        }
+    }
+
+    logger.binary_file     = NULL;
+    logger.formats_written = 0;
+    if (config.binary_file_name) {
+        logger.config.binary_log = true;
+        logger.binary_file       = fopen(config.binary_file_name, "wb");
+
+        if (logger.binary_file) {
+            fwrite("RTBINLOG", 1, 8, logger.binary_file);
+            fwrite(&Binary_Log_Version, sizeof(Binary_Log_Version), 1, logger.binary_file);
+        } else {
+            report("async_log: can't open %s\n", config.binary_file_name);
+            logger.config.binary_log = false;
+        }
+    }
+
+    logger.shutting_down   = false;
+    logger.writer_exited   = false;
+    logger.flush_requested = 0;
+    logger.flush_done      = 0;
+    logger.wake_pending.store(false);
+
+    logger.writer    = std::thread(writer_entrypoint);
+    logger.writer_id = logger.writer.get_id();
+    logger.running.store(true, std::memory_order_release);
+}
+
+void async_log_shutdown() {
+    if (!logger.running.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        logger.shutting_down = true;
+    }
+    logger.wake.notify_one();
+    logger.writer.join();
+
+    if (logger.file) {
+        fclose(logger.file);
+        logger.file = NULL;
+    }
+    if (logger.binary_file) {
+        fclose(logger.binary_file);
+        logger.binary_file = NULL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(logger.mutex);
+        logger.writer_exited = true;
+    }
+    logger.flushed.notify_all();
+}
+
+bool async_log_running() {
+    return logger.running.load(std::memory_order_acquire);
+}
+
+void async_log_flush() {
+    // the sink logging something itself must not wait for its own thread
+    if (!logger.running.load(std::memory_order_acquire) || std::this_thread::get_id() == logger.writer_id) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(logger.mutex);
+
+    u64 ticket = ++logger.flush_requested;
+    logger.wake.notify_one();
+    logger.flushed.wait(lock, [ticket] {
+        return logger.flush_done >= ticket || logger.writer_exited;
+    });
+}
+
+Async_Log_Stats async_log_stats() {
+    Async_Log_Stats stats;
+
+    stats.messages = logger.messages.load(std::memory_order_relaxed);
+    stats.bytes    = logger.bytes.load(std::memory_order_relaxed);
+    stats.dropped  = logger.dropped.load(std::memory_order_relaxed);
+    stats.batches  = logger.batches.load(std::memory_order_relaxed);
+
+    return stats;
+}
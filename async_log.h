@@ -0,0 +1,86 @@
+#ifndef ASYNC_LOG_H_
+#define ASYNC_LOG_H_
+
+#include "typedefs.h"
+
+/*
+===============================================================================
+
+    Asynchronous log backend for report() and the log class.
+
+    Every thread that logs gets its own single producer / single consumer
+    byte ring. A log call copies the already formatted text into the ring
+    of the calling thread - no lock, no syscall - and a background writer
+    thread drains all rings in batches and hands every batch to the sink
+    (debugger output and console window, see ReportOutput) and the log file.
+
+    Messages of one thread stay in order, messages of different threads are
+    only ordered per batch.
+
+    Flush policy: when the log file is flushed to the OS.
+        Log_Flush_Interval    - every flush_interval_ms
+        Log_Flush_Batch       - after every batch the writer wrote
+        Log_Flush_Every_Write - the logging thread waits until its message
+                                is written and flushed, slow but nothing is
+                                lost on a crash
+
+    Full policy: what happens when the ring of a thread is full.
+        Log_Full_Drop  - the message is dropped and counted
+        Log_Full_Block - the logging thread waits for the writer
+
+    Before async_log_init and after async_log_shutdown async_log_write
+    returns false and the caller writes synchronously. A program that
+    exits without async_log_shutdown gets it from an atexit handler, the
+    queued messages are still written.
+
+===============================================================================
+*/
+
+enum Log_Flush_Policy {
+    Log_Flush_Interval,
+    Log_Flush_Batch,
+    Log_Flush_Every_Write,
+};
+
+enum Log_Full_Policy {
+    Log_Full_Drop,
+    Log_Full_Block,
+};
+
+using Log_Sink_Fun = void (*)(const char *text, u64 length);
+
+struct Async_Log_Config {
+    const char      *file_name         = NULL;          // NULL - no log file
+    Log_Sink_Fun     sink              = NULL;          // NULL - ReportOutput
+    u32              ring_size         = 64 * 1024;     // bytes per thread, rounded up to a power of two
+    u32              flush_interval_ms = 100;
+    Log_Flush_Policy flush_policy      = Log_Flush_Interval;
+    Log_Full_Policy  full_policy       = Log_Full_Drop;
+    bool             binary_log        = false;         // log:: records raw arguments, see binary_log.h
+    const char      *binary_file_name  = NULL;          // binary records go unformatted to this file, implies binary_log
+};
+
+struct Async_Log_Stats {
+    u64 messages;
+    u64 bytes;
+    u64 dropped;
+    u64 batches;
+};
+
+void            async_log_init(const Async_Log_Config &config);
+void            async_log_shutdown();
+bool            async_log_running();
+
+// copies the text into the ring of the calling thread, false if the logger isn't running
+bool            async_log_write(const char *text, u64 length);
+
+// binary_log.h record, formatted on the writer thread or written to the binary file
+bool            async_log_write_binary(const u8 *record, u64 size);
+bool            async_log_binary();
+
+// blocks until everything logged before the call is written and flushed
+void            async_log_flush();
+
+Async_Log_Stats async_log_stats();
+
+#endif
@@ -0,0 +1,274 @@
+#include "binary_log.h"
+#include "stringfmt.h"
+#include "util.h"
+
+#include <mutex>
+#include <tuple>
+
+struct Log_Format {
+    std::string  fmt;
+    Log_Level    level;
+    Array_Of<u8> arg_types;
+};
+
+using Log_Format_Key = std::tuple<const char *, const u8 *, Log_Level>;
+
+struct Log_Format_Cache_Entry {
+    const char *fmt;
+    const u8   *arg_types;
+    Log_Level   level;
+    u32         id;
+};
+
+static const u32 Format_Cache_Size = 256;
+
+static std::mutex                      format_mutex;
+static Array_Of<Log_Format>            formats;
+static Map_Of<Log_Format_Key, u32>     format_ids;
+static thread_local Log_Format_Cache_Entry format_cache[Format_Cache_Size];
+
+u32 log_format_id(Log_Level level, const char *fmt, const u8 *arg_types, u32 arg_count) {
+    u64 hash = ((u64(uintptr_t(fmt)) >> 3) ^ (u64(uintptr_t(arg_types)) >> 2) ^ level) * 0x9E3779B97F4A7C15ull;
+
+    Log_Format_Cache_Entry &cached = format_cache[hash >> 56];
+    if (cached.fmt == fmt && cached.arg_types == arg_types && cached.level == level) {
+        return cached.id;
+    }
+
+    std::lock_guard<std::mutex> lock(format_mutex);
+
+    Log_Format_Key key = {fmt, arg_types, level};
+    auto           it  = format_ids.find(key);
+    u32            id;
+
+    if (it != format_ids.end()) {
+        id = it->second;
+    } else {
+        id = u32(formats.size());
+        formats.push_back({fmt, level, Array_Of<u8>(arg_types, arg_types + arg_count)});
+        format_ids[key] = id;
+    }
+
+    cached = {fmt, arg_types, level, id};
+    return id;
+}
+
+template <typename Type>
+static bool read_value(const u8 *&args, const u8 *end, Type &value) {
+    if (u64(end - args) < sizeof(value)) {
+        return false;
+    }
+
+    memcpy(&value, args, sizeof(value));
+    args += sizeof(value);
+    return true;
+}
+
+static bool decode_arg(u8 type, const u8 *&args, const u8 *end, std::string &out) {
+    switch (type) {
+        case Log_Arg_I32: {
+            i32 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_U32: {
+            u32 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_I64: {
+            i64 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_U64: {
+            u64 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_F32: {
+            f32 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_F64: {
+            f64 value;
+            if (!read_value(args, end, value)) {
+                return false;
+            }
+            format_append(out, "/%", value);
+            return true;
+        }
+        case Log_Arg_String: {
+            u32 length;
+            if (!read_value(args, end, length) || u64(end - args) < length) {
+                return false;
+            }
+            out.append((const char *)args, length);
+            args += length;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// same rules as stringf: '/%' is the next argument, '//' is a '/'
+static bool decode_with_format(const Log_Format &format, const u8 *args, const u8 *end, std::string &out) {
+    const char *p         = format.fmt.c_str();
+    u64         arg_index = 0;
+
+    out += log_level_prefix(format.level);
+
+    while (*p) {
+        if (p[0] == '/' && p[1] == '%') {
+            if (arg_index < format.arg_types.size() && !decode_arg(format.arg_types[arg_index], args, end, out)) {
+                return false;
+            }
+            arg_index++;
+            p += 2;
+        } else if (p[0] == '/' && p[1] == '/') {
+            out += '/';
+            p += 2;
+        } else {
+            out += *p++;
+        }
+    }
+
+    return true;
+}
+
+bool log_decode_record(const u8 *record, u64 size, std::string &out) {
+    const u8 *end = record + size;
+    u32       id;
+
+    if (!read_value(record, end, id)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(format_mutex);
+
+    if (id >= formats.size()) {
+        return false;
+    }
+
+    return decode_with_format(formats[id], record, end, out);
+}
+
+void log_append_format_entries(std::string &out, u32 &written) {
+    std::lock_guard<std::mutex> lock(format_mutex);
+
+    for (; written < formats.size(); written++) {
+        const Log_Format &format    = formats[written];
+        u8                arg_count = u8(format.arg_types.size());
+        u32               size      = u32(sizeof(Log_Format_Entry) + sizeof(written) + 2 + arg_count + format.fmt.size());
+
+        out.append((const char *)&size, sizeof(size));
+        out.append((const char *)&Log_Format_Entry, sizeof(Log_Format_Entry));
+        out.append((const char *)&written, sizeof(written));
+        out += char(format.level);
+        out += char(arg_count);
+        out.append((const char *)format.arg_types.data(), arg_count);
+        out += format.fmt;
+    }
+}
+
+bool log_decode_file(const char *binary_file_name, const char *text_file_name) {
+    std::string data;
+    FILE       *file = fopen(binary_file_name, "rb");
+
+    if (!file) {
+        report("log_decode_file: can't open %s\n", binary_file_name);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    data.resize(u64(ftell(file)));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    const u8 *p   = (const u8 *)data.data();
+    const u8 *end = p + data.size();
+    u32       version;
+
+    if (ok && data.size() >= 8 && memcmp(p, "RTBINLOG", 8) == 0) {
+        p += 8;
+        ok = read_value(p, end, version) && version == Binary_Log_Version;
+    } else {
+        ok = false;
+    }
+
+    if (!ok) {
+        report("log_decode_file: %s is not a binary log\n", binary_file_name);
+        return false;
+    }
+
+    Array_Of<Log_Format> file_formats;
+    std::string          text;
+    u64                  records = 0;
+
+    while (p < end) {
+        u32 size;
+        u32 id;
+
+        if (!read_value(p, end, size) || u64(end - p) < size || size < sizeof(id)) {
+            report("log_decode_file: %s is truncated after %llu records\n", binary_file_name, (unsigned long long)records);
+            break;
+        }
+
+        const u8 *entry_end = p + size;
+        read_value(p, entry_end, id);
+
+        if (id == Log_Format_Entry) {
+            u32 format_id;
+
+            if (!read_value(p, entry_end, format_id) || entry_end - p < 2 || entry_end - p < 2 + p[1]) {
+                report("log_decode_file: bad format entry in %s\n", binary_file_name);
+                return false;
+            }
+
+            if (format_id >= file_formats.size()) {
+                file_formats.resize(format_id + 1);
+            }
+
+            Log_Format &format = file_formats[format_id];
+            format.level       = Log_Level(p[0]);
+            format.arg_types.assign(p + 2, p + 2 + p[1]);
+            format.fmt.assign((const char *)p + 2 + p[1], (const char *)entry_end);
+        } else if (id >= file_formats.size() || !decode_with_format(file_formats[id], p, entry_end, text)) {
+            report("log_decode_file: bad record %llu in %s\n", (unsigned long long)records, binary_file_name);
+            return false;
+        } else {
+            records++;
+        }
+
+        p = entry_end;
+    }
+
+    file = fopen(text_file_name, "w");
+    if (!file) {
+        report("log_decode_file: can't write %s\n", text_file_name);
+        return false;
+    }
+
+    ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    fclose(file);
+
+    return ok;
+}
@@ -0,0 +1,188 @@
+#ifndef BINARY_LOG_H_
+#define BINARY_LOG_H_
+
+#include "typedefs.h"
+#include "async_log.h"
+#include "log_level.h"
+
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/*
+===============================================================================
+
+    Deferred binary logging for the log class.
+
+    Instead of formatting on the calling thread a record only holds the id of
+    the format string and the raw argument bytes:
+
+        [u32 format id][arg 0][arg 1]...
+
+    numbers as their native 4 or 8 bytes (bools as u32, long doubles as
+    f64), strings as [u32 length][chars]. Every argument stringf takes works.
+    The id stands for the format string, the argument types and the level,
+    it's registered the first time a call site logs and cached per thread,
+    so a record costs a table lookup and a couple of memcpys.
+
+    The records go through the async log rings. The writer thread either
+    formats them (Async_Log_Config::binary_log) or, with binary_file_name
+    set, writes them unformatted to that file together with the format
+    definitions, log_decode_file turns such a file into text offline
+    (binary_log_decode.cpp is the command line tool for it).
+
+    Binary log file:
+
+        "RTBINLOG" u32 version
+        [u32 size][u32 format id][arguments]        one per record
+        [u32 size][Log_Format_Entry][u32 id][u8 level][u8 arg count][arg types][format]
+
+    A format definition is always written before the first record using it.
+
+===============================================================================
+*/
+
+enum Log_Arg_Type : u8 {
+    Log_Arg_None,
+    Log_Arg_I32,
+    Log_Arg_U32,
+    Log_Arg_I64,
+    Log_Arg_U64,
+    Log_Arg_F32,
+    Log_Arg_F64,
+    Log_Arg_String,
+};
+
+static const u32 Log_Format_Entry   = 0xffffffff;
+static const u32 Binary_Log_Version = 2;
+
+template <typename Type>
+constexpr bool log_arg_is_string() {
+    return (std::is_pointer_v<std::decay_t<Type>> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<std::decay_t<Type>>>, char>) ||
+           std::is_convertible_v<const Type &, std::string_view>;
+}
+
+template <typename Type>
+constexpr u8 log_arg_type() {
+    if constexpr (log_arg_is_string<Type>()) {
+        return Log_Arg_String;
+    } else if constexpr (std::is_same_v<Type, bool>) {
+        // 1 / 0 like stringf
+        return Log_Arg_U32;
+    } else if constexpr (std::is_integral_v<Type>) {
+        if constexpr (sizeof(Type) <= 4) {
+            return std::is_signed_v<Type> || std::is_same_v<Type, char> ? Log_Arg_I32 : Log_Arg_U32;
+        } else {
+            return std::is_signed_v<Type> ? Log_Arg_I64 : Log_Arg_U64;
+        }
+    } else if constexpr (std::is_same_v<Type, float>) {
+        return Log_Arg_F32;
+    } else if constexpr (std::is_floating_point_v<Type>) {
+        return Log_Arg_F64;
+    } else {
+        return Log_Arg_None;
+    }
+}
+
+// one array per argument type list, its address is part of the format id key
+template <typename... Args>
+inline constexpr u8 log_arg_types[] = {log_arg_type<Args>()..., Log_Arg_None};
+
+template <typename Type>
+std::string_view log_arg_string(const Type &value) {
+    if constexpr (std::is_pointer_v<std::decay_t<Type>>) {
+        const char *str = value;
+        return str ? std::string_view(str) : std::string_view("(null)");
+    } else {
+        return std::string_view(value);
+    }
+}
+
+template <typename Type>
+u64 log_arg_size(const Type &value) {
+    if constexpr (log_arg_is_string<Type>()) {
+        return sizeof(u32) + log_arg_string(value).size();
+    } else if constexpr (log_arg_type<Type>() == Log_Arg_I32 || log_arg_type<Type>() == Log_Arg_U32 || log_arg_type<Type>() == Log_Arg_F32) {
+        return 4;
+    } else {
+        return 8;
+    }
+}
+
+template <typename Type>
+u8 *log_put_arg(u8 *out, const Type &value) {
+    constexpr u8 type = log_arg_type<Type>();
+
+    if constexpr (type == Log_Arg_String) {
+        std::string_view str    = log_arg_string(value);
+        u32              length = u32(str.size());
+
+        memcpy(out, &length, sizeof(length));
+        memcpy(out + sizeof(length), str.data(), length);
+        return out + sizeof(length) + length;
+    } else if constexpr (type == Log_Arg_I32) {
+        i32 number = i32(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else if constexpr (type == Log_Arg_U32) {
+        u32 number = u32(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else if constexpr (type == Log_Arg_I64) {
+        i64 number = i64(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else if constexpr (type == Log_Arg_U64) {
+        u64 number = u64(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else if constexpr (type == Log_Arg_F32) {
+        f32 number = f32(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else if constexpr (type == Log_Arg_F64) {
+        // long double too, stringf prints it as a double anyway
+        f64 number = f64(value);
+        memcpy(out, &number, sizeof(number));
+        return out + sizeof(number);
+    } else {
+        static_assert(type != Log_Arg_None, "unsupported binary log argument type");
+        return out;
+    }
+}
+
+// registers the format the first time, afterwards a per thread cache hit
+u32  log_format_id(Log_Level level, const char *fmt, const u8 *arg_types, u32 arg_count);
+
+template <typename... Args>
+bool log_binary(Log_Level level, const char *fmt, const Args &...args) {
+    u64 size = sizeof(u32) + (0 + ... + log_arg_size(args));
+    u8  stack_buffer[512];
+    u8 *record = stack_buffer;
+
+    std::string long_record;
+    if (size > sizeof(stack_buffer)) {
+        long_record.resize(size);
+        record = (u8 *)long_record.data();
+    }
+
+    u32 id = log_format_id(level, fmt, log_arg_types<Args...>, u32(sizeof...(Args)));
+    memcpy(record, &id, sizeof(id));
+
+    u8 *out = record + sizeof(id);
+    ((out = log_put_arg(out, args)), ...);
+
+    return async_log_write_binary(record, size);
+}
+
+// writer side: formats one record with the formats registered in this process
+bool log_decode_record(const u8 *record, u64 size, std::string &out);
+
+// appends the definitions registered since the last call, 'written' is the number already written
+void log_append_format_entries(std::string &out, u32 &written);
+
+// offline decoder: binary log file -> text file
+bool log_decode_file(const char *binary_file_name, const char *text_file_name);
+
+#endif
@@ -0,0 +1,29 @@
+#include "binary_log.h"
+#include "util.h"
+
+#include <string>
+
+//
+// Offline decoder for the files the async log writes with binary_file_name set:
+//
+//     binary_log_decode server.binlog server.log
+//     binary_log_decode server.binlog                 (writes server.binlog.txt)
+//
+// Links against binary_log.cpp and what it uses (async_log, util, platform), the
+// formats come from the file itself so any build of the program can decode any log.
+//
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        report("usage: %s <binary log> [text file]\n", argc > 0 ? argv[0] : "binary_log_decode");
+        return 2;
+    }
+
+    std::string text_file_name = (argc == 3) ? std::string(argv[2]) : std::string(argv[1]) + ".txt";
+
+    if (!log_decode_file(argv[1], text_file_name.c_str())) {
+        return 1;
+    }
+
+    report("%s -> %s\n", argv[1], text_file_name.c_str());
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "cache_bench.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+
+Cache_Trace cache_trace_zipf(i32 length, i32 key_space, f64 skew, u32 seed) {
+    Cache_Trace   trace;
+    Array_Of<f64> cdf;
+    f64           sum = 0.0;
+
+    cdf.resize(key_space);
+    for (i32 i = 0; i < key_space; i++) {
+        sum += 1.0 / std::pow(f64(i + 1), skew);
+        cdf[i] = sum;
+    }
+
+    RandomSeed(seed);
+    trace.reserve(length);
+    for (i32 i = 0; i < length; i++) {
+        f64  r   = f64(RandomF32()) * sum;
+        auto key = std::lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+        trace.push_back(u64(std::min<i64>(key, key_space - 1)));
+    }
+
+    return trace;
+}
+
+Cache_Trace cache_trace_scan(i32 length) {
+    Cache_Trace trace;
+
+    trace.reserve(length);
+    for (i32 i = 0; i < length; i++) {
+        trace.push_back(u64(i));
+    }
+
+    return trace;
+}
+
+Cache_Trace cache_trace_loop(i32 length, i32 key_space) {
+    Cache_Trace trace;
+
+    trace.reserve(length);
+    for (i32 i = 0; i < length; i++) {
+        trace.push_back(u64(i % key_space));
+    }
+
+    return trace;
+}
+
+Cache_Trace cache_trace_from_file(const char *file_name) {
+    Cache_Trace  trace;
+    String_Array lines = VectorFile(file_name);
+
+    trace.reserve(lines.size());
+    for (const std::string &line : lines) {
+        if (line.empty()) {
+            continue;
+        }
+
+        try {
+            trace.push_back(std::stoull(line));
+        } catch (...) {
+            report("cache_trace_from_file: skipping bad key '%s' in %s\n", line.c_str(), file_name);
+        }
+    }
+
+    return trace;
+}
+
+static void report_result(const char *cache_name, const char *trace_name, i32 cache_size, const Cache_Sim_Result &r) {
+    report("%-10s %-12s size %7d  hit ratio %6.2f%%  evictions %9llu  %7.1f ns/op\n", cache_name, trace_name, cache_size,
+           r.hit_ratio * 100.0, (unsigned long long)r.evictions, r.ns_per_op);
+}
+
+static void replay_all_caches(const char *trace_name, const Cache_Trace &trace, i32 key_space) {
+    const f64 size_fractions[] = {0.01, 0.05, 0.10, 0.25};
+
+    for (f64 fraction : size_fractions) {
+        i32 cache_size = std::max(1, i32(f64(key_space) * fraction));
+
+        LRU_Cache<u64, u64> lru(cache_size);
+        report_result("lru", trace_name, cache_size, cache_replay(lru, trace));
+    }
+}
+
+void run_cache_benchmark(const char *trace_file) {
+    constexpr i32 trace_length = 1000000;
+    constexpr i32 key_space    = 100000;
+
+    report("\ncache benchmark: %d operations, %d keys\n", trace_length, key_space);
+    replay_all_caches("zipf_0.8", cache_trace_zipf(trace_length, key_space, 0.8, 1234), key_space);
+    replay_all_caches("zipf_1.2", cache_trace_zipf(trace_length, key_space, 1.2, 1234), key_space);
+    replay_all_caches("scan", cache_trace_scan(trace_length), key_space);
+    replay_all_caches("loop", cache_trace_loop(trace_length, key_space), key_space);
+
+    if (trace_file) {
+        Cache_Trace trace = cache_trace_from_file(trace_file);
+        if (trace.size()) {
+            Cache_Trace unique_keys = trace;
+            std::sort(unique_keys.begin(), unique_keys.end());
+            i32 recorded_key_space = i32(std::unique(unique_keys.begin(), unique_keys.end()) - unique_keys.begin());
+
+            replay_all_caches(trace_file, trace, recorded_key_space);
+        }
+    }
+}
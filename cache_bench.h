@@ -0,0 +1,73 @@
+#ifndef CACHE_BENCH_H_
+#define CACHE_BENCH_H_
+
+#include "typedefs.h"
+#include "lru_cache.h"
+#include "timer.h"
+
+/*
+===============================================================================
+
+     Cache simulation harness: replays a key trace against a cache and reports
+     hit ratio and ns/op. Any cache with the LRU_Cache interface (get, insert,
+     stats) can be replayed, so new implementations and policies plug in
+     without touching the trace generators.
+
+     Traces are either synthetic (zipf, scan, loop) or recorded: a text file
+     with one integer key per line.
+
+===============================================================================
+*/
+
+using Cache_Trace = Array_Of<u64>;
+
+struct Cache_Sim_Result {
+    u64 operations;
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    f64 hit_ratio;
+    f64 ns_per_op;
+};
+
+// skew = 0.0 is uniform, ~0.8 - 1.2 looks like most real key popularity distributions
+Cache_Trace cache_trace_zipf(i32 length, i32 key_space, f64 skew, u32 seed);
+// every key exactly once - a cache can't do anything with this, shows the pollution cost
+Cache_Trace cache_trace_scan(i32 length);
+// cycles over key_space keys - worst case for LRU once key_space > cache size
+Cache_Trace cache_trace_loop(i32 length, i32 key_space);
+Cache_Trace cache_trace_from_file(const char *file_name);
+
+// replays 'trace' on a cold (cleared) cache, every miss inserts the key
+template <typename Cache_Type>
+Cache_Sim_Result cache_replay(Cache_Type &cache, const Cache_Trace &trace) {
+    Cache_Sim_Result result = {};
+    High_Res_Timer   timer;
+    u64              value;
+
+    cache.clear();
+    timer.reset();
+    for (u64 key : trace) {
+        // counted here, the cache's own stats can be compiled out (LRU_CACHE_STATS 0)
+        if (cache.get(key, value)) {
+            result.hits++;
+        } else {
+            result.misses++;
+            cache.insert(key, key);
+        }
+    }
+    f64 elapsed_us = timer.get_time_micro();
+
+    result.operations = trace.size();
+    result.evictions  = cache.stats.evictions; // 0 without LRU_CACHE_STATS
+    result.hit_ratio  = result.operations ? f64(result.hits) / f64(result.operations) : 0.0;
+    result.ns_per_op  = result.operations ? (elapsed_us * 1000.0) / f64(result.operations) : 0.0;
+
+    return result;
+}
+
+// replays the synthetic traces (and 'trace_file' if not NULL) against every cache
+// implementation at a few sizes and reports the results
+void run_cache_benchmark(const char *trace_file);
+
+#endif
@@ -0,0 +1,222 @@
+#include "histogram.h"
+#include "util.h"
+
+#include <mutex>
+#include <string.h>
+
+struct Histogram_Shard {
+    Latency_Histogram histogram;
+    std::atomic<bool> in_use;
+    Histogram_Shard  *next;
+};
+
+struct Named_Histogram {
+    const char                      *name;
+    std::atomic<Histogram_Shard *>   shards;
+};
+
+// gives the shards of a thread back when it exits, the counts stay in them
+struct Histogram_Shard_Owner {
+    Histogram_Shard *shards[Histogram_Max_Named] = {};
+
+    ~Histogram_Shard_Owner() {
+        for (u32 i = 0; i < Histogram_Max_Named; i++) {
+            if (shards[i]) {
+                histogram_shards[i] = NULL;
+                shards[i]->in_use.store(false, std::memory_order_release);
+            }
+        }
+    }
+};
+
+static std::mutex                         histogram_mutex;
+static Named_Histogram                    named[Histogram_Max_Named];
+static std::atomic<u32>                   named_count;
+static thread_local Histogram_Shard_Owner shard_owner;
+
+void histogram_reset(Latency_Histogram &histogram) {
+    for (std::atomic<u64> &count : histogram.counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    histogram.sum.store(0, std::memory_order_relaxed);
+    histogram.max.store(0, std::memory_order_relaxed);
+}
+
+void histogram_merge(Histogram_Snapshot &snapshot, const Latency_Histogram &histogram) {
+    for (u32 i = 0; i < Histogram_Buckets; i++) {
+        u64 count = histogram.counts[i].load(std::memory_order_relaxed);
+
+        snapshot.counts[i] += count;
+        snapshot.count += count;
+    }
+
+    u64 max = histogram.max.load(std::memory_order_relaxed);
+
+    snapshot.sum += histogram.sum.load(std::memory_order_relaxed);
+    snapshot.max = max > snapshot.max ? max : snapshot.max;
+}
+
+void histogram_merge(Histogram_Snapshot &snapshot, const Histogram_Snapshot &other) {
+    for (u32 i = 0; i < Histogram_Buckets; i++) {
+        snapshot.counts[i] += other.counts[i];
+    }
+
+    snapshot.count += other.count;
+    snapshot.sum += other.sum;
+    snapshot.max = other.max > snapshot.max ? other.max : snapshot.max;
+}
+
+void histogram_subtract(Histogram_Snapshot &snapshot, const Histogram_Snapshot &earlier) {
+    u64 highest = 0;
+
+    snapshot.count = 0;
+    for (u32 i = 0; i < Histogram_Buckets; i++) {
+        // the counters only grow, a later snapshot is never behind an earlier one
+        snapshot.counts[i] -= earlier.counts[i];
+        snapshot.count += snapshot.counts[i];
+
+        if (snapshot.counts[i]) {
+            highest = histogram_bucket_high(i);
+        }
+    }
+
+    snapshot.sum -= earlier.sum;
+    snapshot.max = highest < snapshot.max ? highest : snapshot.max;
+}
+
+u64 histogram_percentile(const Histogram_Snapshot &snapshot, f64 percentile) {
+    if (snapshot.count == 0) {
+        return 0;
+    }
+
+    // the rank of the sample, 1 based
+    u64 rank = u64(percentile * 0.01 * f64(snapshot.count) + 0.5);
+    rank     = rank < 1 ? 1 : rank > snapshot.count ? snapshot.count : rank;
+
+    u64 seen = 0;
+    for (u32 i = 0; i < Histogram_Buckets; i++) {
+        seen += snapshot.counts[i];
+
+        if (seen >= rank) {
+            u64 value = histogram_bucket_high(i);
+            return value < snapshot.max ? value : snapshot.max;
+        }
+    }
+
+    return snapshot.max;
+}
+
+f64 histogram_mean(const Histogram_Snapshot &snapshot) {
+    return snapshot.count ? f64(snapshot.sum) / f64(snapshot.count) : 0.0;
+}
+
+std::string histogram_format(const char *name, const Histogram_Snapshot &snapshot) {
+    return StringF("%-32s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", name, (unsigned long long)snapshot.count,
+                   histogram_mean(snapshot) * 0.001, f64(histogram_percentile(snapshot, 50.0)) * 0.001,
+                   f64(histogram_percentile(snapshot, 99.0)) * 0.001, f64(histogram_percentile(snapshot, 99.9)) * 0.001,
+                   f64(snapshot.max) * 0.001);
+}
+
+static std::string histogram_header() {
+    return StringF("%-32s %10s %10s %10s %10s %10s %10s\n", "histogram (us)", "count", "mean", "p50", "p99", "p999", "max");
+}
+
+/*
+===============================================================================
+    named, per thread sharded histograms
+===============================================================================
+*/
+
+Histogram_Id histogram_register(const char *name) {
+    std::lock_guard<std::mutex> lock(histogram_mutex);
+
+    u32 count = named_count.load(std::memory_order_relaxed);
+
+    for (u32 i = 0; i < count; i++) {
+        if (strcmp(named[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    if (count == Histogram_Max_Named) {
+        Panic(StringF("histogram_register: more than %u histograms, raise Histogram_Max_Named", Histogram_Max_Named));
+    }
+
+    named[count].name = name;
+    named_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+const char *histogram_name(Histogram_Id id) {
+    return named[id].name;
+}
+
+u32 histogram_count() {
+    return named_count.load(std::memory_order_acquire);
+}
+
+Latency_Histogram *histogram_acquire_shard(Histogram_Id id) {
+    std::lock_guard<std::mutex> lock(histogram_mutex);
+
+    Named_Histogram &histogram = named[id];
+    Histogram_Shard *shard     = NULL;
+
+    // a shard of an exited thread keeps its counts, the new owner just adds to them
+    for (Histogram_Shard *it = histogram.shards.load(std::memory_order_acquire); it; it = it->next) {
+        bool expected = false;
+
+        if (it->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            shard = it;
+            break;
+        }
+    }
+
+    if (!shard) {
+        shard = new Histogram_Shard();
+        shard->in_use.store(true, std::memory_order_relaxed);
+        shard->next = histogram.shards.load(std::memory_order_relaxed);
+        histogram.shards.store(shard, std::memory_order_release);
+    }
+
+    shard_owner.shards[id] = shard;
+    histogram_shards[id]   = &shard->histogram;
+    return &shard->histogram;
+}
+
+void histogram_snapshot(Histogram_Id id, Histogram_Snapshot &snapshot) {
+    memset(&snapshot, 0, sizeof(snapshot));
+
+    for (Histogram_Shard *shard = named[id].shards.load(std::memory_order_acquire); shard; shard = shard->next) {
+        histogram_merge(snapshot, shard->histogram);
+    }
+}
+
+void histogram_report(const char *file_name) {
+    // ~15k, too much for the stack of every caller
+    Histogram_Snapshot *snapshot = new Histogram_Snapshot;
+    std::string         out      = histogram_header();
+
+    for (u32 id = 0; id < histogram_count(); id++) {
+        histogram_snapshot(id, *snapshot);
+
+        if (snapshot->count) {
+            out += histogram_format(histogram_name(id), *snapshot);
+        }
+    }
+
+    delete snapshot;
+
+    if (!file_name) {
+        report("\n%s", out.c_str());
+        return;
+    }
+
+    FILE *file = fopen(file_name, "w");
+    if (!file) {
+        report("histogram_report: can't open %s\n", file_name);
+        return;
+    }
+
+    fwrite(out.data(), 1, out.size(), file);
+    fclose(file);
+}
@@ -0,0 +1,144 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include "typedefs.h"
+
+/*
+===============================================================================
+
+    Latency histograms, log-linear buckets like HdrHistogram.
+
+    Values (ns) below 2^HISTOGRAM_SUB_BUCKET_BITS get a bucket each, above
+    that every power of two is split into 2^HISTOGRAM_SUB_BUCKET_BITS linear
+    sub buckets, so a percentile is off by at most 1 / 2^bits of the value
+    (~3% with 5 bits) over the whole u64 range.
+
+    Latency_Histogram is a fixed array of relaxed atomic counters, recording
+    is a few fetch_adds and never locks or allocates. Histograms of the same
+    range are merged by adding the buckets.
+
+    Named histograms are sharded per thread:
+
+        static const Histogram_Id frame_time = histogram_register("frame");
+
+        u64 start = timer_ticks();
+        ...
+        histogram_record(frame_time, timer_ticks_to_ns(timer_ticks() - start));
+
+    every thread records into its own shard (no contended cache lines), a
+    snapshot adds up the shards. Snapshots only grow, the difference of two
+    (histogram_subtract) is the interval between them. metrics.h exports
+    the named histograms with the counters and gauges.
+
+===============================================================================
+*/
+
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+
+static const u32 Histogram_Sub_Buckets = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+static const u32 Histogram_Buckets     = (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * Histogram_Sub_Buckets;
+static const u32 Histogram_Max_Named   = 64;
+
+struct Latency_Histogram {
+    std::atomic<u64> counts[Histogram_Buckets];
+    std::atomic<u64> sum;
+    std::atomic<u64> max;
+};
+
+// plain copy of one or more histograms, what the queries work on
+struct Histogram_Snapshot {
+    u64 counts[Histogram_Buckets];
+    u64 count;
+    u64 sum;
+    u64 max;
+};
+
+using Histogram_Id = u32;
+
+inline u32 histogram_bucket(u64 value) {
+    if (value < Histogram_Sub_Buckets) {
+        return u32(value);
+    }
+
+#ifdef _MSC_VER
+    unsigned long msb;
+    _BitScanReverse64(&msb, value);
+#else
+    u32 msb = 63 - u32(__builtin_clzll(value));
+#endif
+
+    // the top HISTOGRAM_SUB_BUCKET_BITS + 1 bits of the value pick the sub bucket
+    u32 shift = u32(msb) - HISTOGRAM_SUB_BUCKET_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + u32(value >> shift) - Histogram_Sub_Buckets;
+}
+
+// the smallest and the largest value that land in the bucket
+inline u64 histogram_bucket_low(u32 bucket) {
+    u32 group = bucket >> HISTOGRAM_SUB_BUCKET_BITS;
+    u64 sub   = bucket & (Histogram_Sub_Buckets - 1);
+
+    return group == 0 ? sub : (sub + Histogram_Sub_Buckets) << (group - 1);
+}
+
+inline u64 histogram_bucket_high(u32 bucket) {
+    u32 group = bucket >> HISTOGRAM_SUB_BUCKET_BITS;
+
+    return group == 0 ? bucket : histogram_bucket_low(bucket) + ((u64(1) << (group - 1)) - 1);
+}
+
+inline void histogram_record(Latency_Histogram &histogram, u64 value) {
+    histogram.counts[histogram_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    histogram.sum.fetch_add(value, std::memory_order_relaxed);
+
+    u64 max = histogram.max.load(std::memory_order_relaxed);
+    while (value > max && !histogram.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void histogram_reset(Latency_Histogram &histogram);
+
+void histogram_merge(Histogram_Snapshot &snapshot, const Latency_Histogram &histogram);
+void histogram_merge(Histogram_Snapshot &snapshot, const Histogram_Snapshot &other);
+
+// leaves what was recorded after 'earlier', the max is estimated from the highest bucket left
+void histogram_subtract(Histogram_Snapshot &snapshot, const Histogram_Snapshot &earlier);
+
+// percentile in [0, 100], the highest value of the bucket it falls into but never more than the max, 0 if empty
+u64  histogram_percentile(const Histogram_Snapshot &snapshot, f64 percentile);
+f64  histogram_mean(const Histogram_Snapshot &snapshot);
+
+// "name count mean p50 p99 p999 max" line, values in us
+std::string histogram_format(const char *name, const Histogram_Snapshot &snapshot);
+
+/*
+===============================================================================
+    named, per thread sharded histograms
+===============================================================================
+*/
+
+// the same name gives the same id, at most Histogram_Max_Named
+Histogram_Id       histogram_register(const char *name);
+const char        *histogram_name(Histogram_Id id);
+u32                histogram_count();
+
+Latency_Histogram *histogram_acquire_shard(Histogram_Id id);
+
+inline thread_local Latency_Histogram *histogram_shards[Histogram_Max_Named];
+
+inline void histogram_record(Histogram_Id id, u64 value) {
+    Latency_Histogram *shard = histogram_shards[id];
+
+    if (!shard) {
+        shard = histogram_acquire_shard(id);
+    }
+
+    histogram_record(*shard, value);
+}
+
+// all shards of the histogram added up
+void histogram_snapshot(Histogram_Id id, Histogram_Snapshot &snapshot);
+
+// the named histograms through report() or to a file
+void histogram_report(const char *file_name);
+
+#endif
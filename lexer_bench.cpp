@@ -0,0 +1,363 @@
+#include "lexer_bench.h"
+#include "memory.h"
+#include "registry.h"
+#include "timer.h"
+#include "tokenizer.h"
+#include "util.h"
+
+#include <cstdio>
+#include <ctime>
+
+// the script corpus is lexed like a small C like language
+constexpr Lexer_Config script_lexer_config(Comment_Double_Slash | Comment_Block, "{}()[];,=:",
+                                           {"if", "else", "while", "for", "return", "break", "continue", "function", "var"});
+
+static const char *corpus_names[Corpus_Count] = {"small_blocks", "long_strings", "comment_heavy", "number_heavy", "script"};
+
+const char *lexer_corpus_name(Lexer_Corpus_Shape shape) {
+    return corpus_names[shape];
+}
+
+static void append_word(std::string &out, i32 min_length, i32 max_length) {
+    i32 length = min_length + RandomI32(max_length - min_length + 1);
+    for (i32 i = 0; i < length; i++) {
+        out += char('a' + RandomI32(26));
+    }
+}
+
+static void append_number(std::string &out) {
+    switch (RandomI32(4)) {
+        case 0:
+            out += StringF("%d", RandomI32(100000) - 50000);
+            break;
+        case 1:
+            out += StringF("%.4f", f64(RandomF32()) * 1000.0 - 500.0);
+            break;
+        case 2:
+            out += StringF("%de%d", RandomI32(100), RandomI32(20) - 10);
+            break;
+        default:
+            out += StringF("0x%X", RandomI32(0x7fffffff));
+            break;
+    }
+}
+
+static void append_small_block(std::string &out, i32 block) {
+    out += StringF("config \"small_%d\" {\n", block);
+    i32 keys = 3 + RandomI32(4);
+    for (i32 i = 0; i < keys; i++) {
+        out += StringF("    lexer_bench.small.k%d_%d = \"", block, i);
+        append_word(out, 2, 12);
+        out += "\"\n";
+    }
+    out += "}\n\n";
+}
+
+static void append_long_string_block(std::string &out, i32 block) {
+    out += StringF("config \"long_%d\" {\n", block);
+    for (i32 i = 0; i < 4; i++) {
+        out += StringF("    lexer_bench.long.k%d_%d = \"", block, i);
+        i32 words = 30 + RandomI32(300);
+        for (i32 w = 0; w < words; w++) {
+            append_word(out, 1, 10);
+            out += ' ';
+        }
+        out += "\"\n";
+    }
+    out += "}\n\n";
+}
+
+static void append_comment_block(std::string &out, i32 block) {
+    out += StringF("# block %d\nconfig \"comment_%d\" {\n", block, block);
+    for (i32 i = 0; i < 4; i++) {
+        i32 comments = 1 + RandomI32(4);
+        for (i32 c = 0; c < comments; c++) {
+            out += "    # ";
+            i32 words = 4 + RandomI32(12);
+            for (i32 w = 0; w < words; w++) {
+                append_word(out, 1, 9);
+                out += ' ';
+            }
+            out += '\n';
+        }
+        out += StringF("    lexer_bench.comment.k%d_%d = \"", block, i);
+        append_word(out, 2, 12);
+        out += "\"   # trailing comment\n";
+    }
+    out += "}\n\n";
+}
+
+static void append_number_line(std::string &out, i32 line) {
+    out += StringF("values_%d = ", line);
+    i32 count = 4 + RandomI32(12);
+    for (i32 i = 0; i < count; i++) {
+        append_number(out);
+        out += ' ';
+    }
+    out += '\n';
+}
+
+static void append_script_function(std::string &out, i32 function) {
+    out += StringF("// function %d\nfunction f%d(a, b, c) {\n", function, function);
+    i32 statements = 4 + RandomI32(12);
+    for (i32 i = 0; i < statements; i++) {
+        switch (RandomI32(5)) {
+            case 0:
+                out += StringF("    var v%d = ", i);
+                append_number(out);
+                out += ";\n";
+                break;
+            case 1:
+                out += StringF("    if (a) {\n        return b[%d];\n    } else {\n        c = g(a, b);\n    }\n", RandomI32(16));
+                break;
+            case 2:
+                out += "    while (c) {\n        c = next(c, \"text\");\n    }\n";
+                break;
+            case 3:
+                out += "    /* block comment\n       over two lines */\n";
+                break;
+            default:
+                out += "    call(a, b, c); // trailing comment\n";
+                break;
+        }
+    }
+    out += "    return a;\n}\n\n";
+}
+
+std::string lexer_corpus(Lexer_Corpus_Shape shape, u64 target_bytes, u32 seed) {
+    std::string out;
+    out.reserve(target_bytes + 4096);
+
+    RandomSeed(seed);
+    for (i32 i = 0; out.size() < target_bytes; i++) {
+        switch (shape) {
+            case Corpus_Small_Blocks:
+                append_small_block(out, i);
+                break;
+            case Corpus_Long_Strings:
+                append_long_string_block(out, i);
+                break;
+            case Corpus_Comment_Heavy:
+                append_comment_block(out, i);
+                break;
+            case Corpus_Number_Heavy:
+                append_number_line(out, i);
+                break;
+            default:
+                append_script_function(out, i);
+                break;
+        }
+    }
+
+    return out;
+}
+
+/*
+====================
+token loops - every one returns the number of tokens it has seen
+====================
+*/
+static u64 bench_get_token(const std::string &text, const Lexer_Config *config) {
+    Lexer lexer;
+    u64   tokens = 0;
+
+    lexer.config = config;
+    lexer.FromMemory(text.data(), text.size());
+    while (lexer.state.ok && lexer.GetToken().type != Token_End) {
+        tokens++;
+    }
+
+    return tokens;
+}
+
+static u64 bench_get_token_view(const std::string &text, const Lexer_Config *config) {
+    Lexer lexer;
+    u64   tokens = 0;
+
+    lexer.config = config;
+    lexer.FromMemory(text.data(), text.size());
+    while (lexer.state.ok && lexer.GetTokenView().type != Token_End) {
+        tokens++;
+    }
+
+    return tokens;
+}
+
+// the parse_block pattern: look at every token before taking it
+static u64 bench_peek_heavy(const std::string &text, const Lexer_Config *config) {
+    Lexer lexer;
+    u64   tokens = 0;
+
+    lexer.config = config;
+    lexer.FromMemory(text.data(), text.size());
+    while (lexer.state.ok) {
+        Token peeked = lexer.PeekToken();
+        if (peeked.type == Token_End) {
+            break;
+        }
+
+        Token_View token;
+        if (!lexer.ExpectToken(token, peeked.type)) {
+            break;
+        }
+        tokens++;
+    }
+
+    return tokens;
+}
+
+static u64 bench_tokenize_parallel(const std::string &text, const Lexer_Config *config) {
+    Array_Of<Token_View> tokens;
+
+    TokenizeParallel(text, tokens, config);
+    return tokens.empty() ? 0 : tokens.size() - 1;
+}
+
+using Bench_Fun = u64 (*)(const std::string &text, const Lexer_Config *config);
+
+struct Bench_Results {
+    Array_Of<Lexer_Bench_Result> results;
+    FILE *                       csv;
+};
+
+static void add_result(Bench_Results &out, const Lexer_Bench_Result &r) {
+    report("%-18s %-14s %8.1f MB/s  %11.0f tokens/s  %6.3f allocs/token\n", r.benchmark, r.corpus, r.mb_per_s, r.tokens_per_s,
+           r.allocs_per_token);
+
+    if (out.csv) {
+        fprintf(out.csv, "%lld,%s,%s,%llu,%llu,%.6f,%.2f,%.0f,%.4f\n", (long long)time(NULL), r.benchmark, r.corpus,
+                (unsigned long long)r.bytes, (unsigned long long)r.tokens, r.seconds, r.mb_per_s, r.tokens_per_s, r.allocs_per_token);
+    }
+    out.results.push_back(r);
+}
+
+static Lexer_Bench_Result make_result(const char *benchmark, const char *corpus, u64 bytes, u64 tokens, u64 allocations, f64 seconds) {
+    Lexer_Bench_Result r = {};
+
+    r.benchmark        = benchmark;
+    r.corpus           = corpus;
+    r.bytes            = bytes;
+    r.tokens           = tokens;
+    r.allocations      = allocations;
+    r.seconds          = seconds;
+    r.mb_per_s         = seconds > 0.0 ? f64(bytes) / (seconds * 1000000.0) : 0.0;
+    r.tokens_per_s     = seconds > 0.0 ? f64(tokens) / seconds : 0.0;
+    r.allocs_per_token = tokens ? f64(allocations) / f64(tokens) : 0.0;
+    return r;
+}
+
+// best of 'runs', the first run also warms the caches
+static void run_token_bench(Bench_Results &out, const char *benchmark, Bench_Fun fun, const std::string &text, const char *corpus,
+                            const Lexer_Config *config) {
+    constexpr i32  runs = 3;
+    High_Res_Timer timer;
+    f64            best_seconds = 1e30;
+    u64            tokens       = 0;
+    u64            allocations  = 0;
+
+    for (i32 run = 0; run < runs; run++) {
+        u64 allocs_before = mem_alloc_count();
+        timer.reset();
+        tokens      = fun(text, config);
+        f64 seconds = timer.get_time_micro() / 1000000.0;
+        allocations = mem_alloc_count() - allocs_before;
+
+        best_seconds = (seconds < best_seconds) ? seconds : best_seconds;
+    }
+
+    add_result(out, make_result(benchmark, corpus, text.size(), tokens, allocations, best_seconds));
+}
+
+// 'tokens' comes from the token loops, reg_check doesn't count them
+static void run_reg_load_bench(Bench_Results &out, const char *benchmark, const char *file_name, u64 bytes, u64 tokens, const char *corpus) {
+    constexpr i32  runs = 3;
+    High_Res_Timer timer;
+    f64            best_seconds = 1e30;
+    u64            allocations  = 0;
+
+    for (i32 run = 0; run < runs; run++) {
+        u64 allocs_before = mem_alloc_count();
+        timer.reset();
+        bool ok     = reg_check(file_name);
+        f64 seconds = timer.get_time_micro() / 1000000.0;
+        allocations = mem_alloc_count() - allocs_before;
+
+        if (!ok) {
+            report("lexer benchmark: reg_check(%s) failed\n", file_name);
+            return;
+        }
+        best_seconds = (seconds < best_seconds) ? seconds : best_seconds;
+    }
+
+    add_result(out, make_result(benchmark, corpus, bytes, tokens, allocations, best_seconds));
+}
+
+static bool write_corpus_file(const char *file_name, const std::string &text) {
+    FILE *file = fopen(file_name, "wb");
+    if (!file) {
+        report("lexer benchmark: can't write %s\n", file_name);
+        return false;
+    }
+
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    fclose(file);
+    return ok;
+}
+
+//
+// The reg_load_* runs load the config corpora with reg_check, every run builds the whole
+// snapshot from the file and throws it away - nothing lands in the live registry.
+//
+void run_lexer_benchmark(const char *results_file) {
+    constexpr u64 corpus_bytes = 8 * 1024 * 1024;
+    Bench_Results out          = {};
+
+    // numbers of a lexer that gets it wrong are worthless
+    if (!LexerSelfTest(1234)) {
+        report("lexer benchmark: the self test failed, no benchmark\n");
+        return;
+    }
+
+    if (results_file) {
+        out.csv = fopen(results_file, "ab");
+        if (!out.csv) {
+            report("lexer benchmark: can't open %s\n", results_file);
+        } else if (fseek(out.csv, 0, SEEK_END) == 0 && ftell(out.csv) == 0) {
+            fprintf(out.csv, "unix_time,benchmark,corpus,bytes,tokens,seconds,mb_per_s,tokens_per_s,allocs_per_token\n");
+        }
+    }
+
+    report("\nlexer benchmark: %llu KB per corpus\n", (unsigned long long)(corpus_bytes / 1024));
+    for (i32 shape = 0; shape < Corpus_Count; shape++) {
+        const char *        corpus = lexer_corpus_name(Lexer_Corpus_Shape(shape));
+        std::string         text   = lexer_corpus(Lexer_Corpus_Shape(shape), corpus_bytes, 1234 + shape);
+        const Lexer_Config *config = (shape == Corpus_Script) ? &script_lexer_config : &default_lexer_config;
+
+        run_token_bench(out, "get_token", bench_get_token, text, corpus, config);
+        run_token_bench(out, "get_token_view", bench_get_token_view, text, corpus, config);
+        run_token_bench(out, "peek_heavy", bench_peek_heavy, text, corpus, config);
+        run_token_bench(out, "tokenize_parallel", bench_tokenize_parallel, text, corpus, config);
+
+        if (shape == Corpus_Number_Heavy || shape == Corpus_Script) {
+            continue;
+        }
+
+        std::string file_name  = StringF("lexer_bench_%s.cfg", corpus);
+        std::string image_name = file_name + ".bin";
+        u64         tokens     = out.results.back().tokens;
+
+        if (write_corpus_file(file_name.c_str(), text)) {
+            run_reg_load_bench(out, "reg_load_text", file_name.c_str(), text.size(), tokens, corpus);
+            if (reg_compile(file_name.c_str())) {
+                run_reg_load_bench(out, "reg_load_image", file_name.c_str(), text.size(), tokens, corpus);
+            }
+        }
+
+        std::remove(image_name.c_str());
+        std::remove(file_name.c_str());
+    }
+
+    if (out.csv) {
+        fclose(out.csv);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef LEXER_BENCH_H_
+#define LEXER_BENCH_H_
+
+#include "typedefs.h"
+
+/*
+===============================================================================
+
+     Lexer and registry parsing benchmark: generates synthetic corpora of
+     different shapes, runs the token loops and the registry loading over
+     them and reports MB/s, tokens/s and allocations per token.
+
+     Every result is also appended as one CSV line to 'results_file' (if not
+     NULL) so numbers can be compared between builds:
+
+         unix_time,benchmark,corpus,bytes,tokens,seconds,mb_per_s,tokens_per_s,allocs_per_token
+
+     Allocations are operator new calls on the benchmark thread, they are 0
+     unless memory.cpp is built with COUNT_MEM_ALLOC=1.
+
+     The registry runs go through reg_check, the live registry is left
+     alone.
+
+===============================================================================
+*/
+
+enum Lexer_Corpus_Shape {
+    Corpus_Small_Blocks,  // lots of config blocks with a handful of short keys
+    Corpus_Long_Strings,  // few keys with long string values
+    Corpus_Comment_Heavy, // more comment lines than keys
+    Corpus_Number_Heavy,  // lines of number literals, lexer only - not a registry file
+    Corpus_Script,        // C like script lexed with comments, keywords and punctuation
+    Corpus_Count
+};
+
+struct Lexer_Bench_Result {
+    const char *benchmark;
+    const char *corpus;
+    u64         bytes;
+    u64         tokens;
+    u64         allocations;
+    f64         seconds;
+    f64         mb_per_s;
+    f64         tokens_per_s;
+    f64         allocs_per_token;
+};
+
+const char *lexer_corpus_name(Lexer_Corpus_Shape shape);
+std::string lexer_corpus(Lexer_Corpus_Shape shape, u64 target_bytes, u32 seed);
+
+// runs every benchmark over every corpus shape, tokenize_parallel is sequential unless the worker runs (worker.init)
+void run_lexer_benchmark(const char *results_file);
+
+#endif
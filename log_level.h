@@ -0,0 +1,118 @@
+#ifndef LOG_LEVEL_H_
+#define LOG_LEVEL_H_
+
+#include "typedefs.h"
+
+#include <atomic>
+#include <chrono>
+
+/*
+===============================================================================
+
+    Log severity, filtering and rate limiting.
+
+    LOG_COMPILE_LEVEL strips every LOG_* call below it at compile time, the
+    runtime level (log_set_level) is checked by the macros before any
+    argument is evaluated, so a disabled call costs one relaxed load and a
+    compare.
+
+        LOG_DEBUG("cache miss /%\n", key);
+        LOG_RATE_LIMITED(Log_Warning, 10, "queue full, dropping /%\n", id);
+        REPORT(Log_Debug, "%d blocks\n", count);
+
+    LOG_RATE_LIMITED lets 'per_second' messages of its call site through per
+    one second window and reports how many it swallowed when the next window
+    lets one through.
+
+===============================================================================
+*/
+
+enum Log_Level : u8 {
+    Log_Trace,
+    Log_Debug,
+    Log_Info,
+    Log_Warning,
+    Log_Error,
+};
+
+// calls below this level are compiled out, 0 trace .. 4 error
+#ifndef LOG_COMPILE_LEVEL
+#ifdef _DEBUG
+#define LOG_COMPILE_LEVEL 0
+#else
+#define LOG_COMPILE_LEVEL 2
+#endif
+#endif
+
+// everything compiled in is enabled until log_set_level
+inline std::atomic<u8> log_runtime_level = LOG_COMPILE_LEVEL;
+
+inline bool log_enabled(Log_Level level) {
+    return level >= log_runtime_level.load(std::memory_order_relaxed);
+}
+
+inline void log_set_level(Log_Level level) {
+    log_runtime_level.store(level, std::memory_order_relaxed);
+}
+
+inline const char *log_level_prefix(Log_Level level) {
+    switch (level) {
+        case Log_Trace:
+            return "  [TRACE] ";
+        case Log_Debug:
+            return "  [DEBUG] ";
+        case Log_Info:
+            return "   [INFO] ";
+        case Log_Warning:
+            return "[WARNING] ";
+        case Log_Error:
+            return "  [ERROR] ";
+    }
+
+    return "";
+}
+
+// one per call site, fixed one second windows
+struct Log_Rate_Limit {
+    // second of the window << 32 | messages let through in it, one CAS starts a window and counts in it
+    std::atomic<u64> window = 0;
+
+    // a storm still counts here, on its own line the window stays shared between the cores
+    alignas(64) std::atomic<u32> suppressed = 0;
+
+    // true if the message may go out, 'suppressed_before' is the number swallowed since the last one that did
+    bool allow(u32 per_second, u32 &suppressed_before) {
+        u64 now    = u64(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        u64 second = (now & 0xffffffff) << 32;
+        u64 state  = window.load(std::memory_order_relaxed);
+        u64 next;
+
+        do {
+            if ((state & 0xffffffff00000000) != second) {
+                next = second | 1;
+            } else if (u32(state) < per_second) {
+                next = state + 1;
+            } else {
+                // over the limit: the window is only read, the count is one relaxed RMW
+                suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!window.compare_exchange_weak(state, next, std::memory_order_relaxed));
+
+        suppressed_before = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+#define LOG_COMPILED(level) (int(level) >= LOG_COMPILE_LEVEL)
+
+#define REPORT(level, ...)                                    \
+    do {                                                      \
+        if constexpr (LOG_COMPILED(level)) {                  \
+            if (log_enabled(level)) {                         \
+                report(__VA_ARGS__);                          \
+            }                                                 \
+        }                                                     \
+    } while (0)
+
+#endif
@@ -28,7 +28,7 @@ For more information, please refer to <http://unlicense.org>
 #ifndef LOG_H_
 #define LOG_H_
 
-#include <Windows.h>
+#include "platform.h"
 
 #include <cstdio>
 #include <string>
@@ -37,12 +37,15 @@ For more information, please refer to <http://unlicense.org>
 #include "timer.h"
 
 #include "stringfmt.h"
+#include "async_log.h"
+#include "binary_log.h"
+#include "log_level.h"
 
 class log
 {    
 protected:
     
-    HighResTimer    mTimer;
+    High_Res_Timer  mTimer;
 
     std::ofstream   mLogFile;
     std::mutex      mLogMutex;
@@ -58,34 +61,131 @@ protected:
         return theInstance;
     }
 
-    void printLine(const std::string &line)
+    void printLine(const char *line, size_t length)
     {
+        // goes to the async log file and sink while the async log runs
+        if (async_log_write(line, length))
+        {
+            return;
+        }
+
         std::lock_guard<std::mutex> lock{mLogMutex};
 
         if (mLogFile.is_open())
         {
-            mLogFile << line;
+            mLogFile.write(line, length);
             mLogFile.flush();
         }
 
-        OutputDebugStringA(line.c_str());
+        platform_debug_output(line);
     }
 
 public:
 
+    // formats even if the level is disabled at runtime, the LOG_* macros check first
+    template <typename ...Args>
+    static void write(Log_Level level, Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        // formatted later by the async log writer or offline
+        if (async_log_binary())
+        {
+            log_binary(level, fmt.fmt, args...);
+            return;
+        }
+
+        Format_Buffer &line = thread_format_buffer();
+
+        line.format("/%", log_level_prefix(level));
+        line.append<Args...>(fmt, args...);
+        it().printLine(line.c_str(), line.size());
+    }
+
+    template <typename ...Args>
+    static void trace(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        if (log_enabled(Log_Trace))
+        {
+            write<Args...>(Log_Trace, fmt, args...);
+        }
+    }
+
     template <typename ...Args>
-    static void info(const char *fmt, const Args&... args)
+    static void debug(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
     {
-        std::string line = {"   [INFO] " + stringf(fmt, args...)};        
-        it().printLine(line);
+        if (log_enabled(Log_Debug))
+        {
+            write<Args...>(Log_Debug, fmt, args...);
+        }
     }
 
     template <typename ...Args>
-    static void error(const char *fmt, const Args&... args)
+    static void info(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
     {
-        std::string line = {"  [ERROR] " + stringf(fmt, args...)};
-        it().printLine(line);
+        if (log_enabled(Log_Info))
+        {
+            write<Args...>(Log_Info, fmt, args...);
+        }
+    }
+
+    template <typename ...Args>
+    static void warning(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        if (log_enabled(Log_Warning))
+        {
+            write<Args...>(Log_Warning, fmt, args...);
+        }
+    }
+
+    template <typename ...Args>
+    static void error(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        if (log_enabled(Log_Error))
+        {
+            write<Args...>(Log_Error, fmt, args...);
+        }
     }
 };
 
+/*
+    Prefer these over calling log:: directly: below LOG_COMPILE_LEVEL the call
+    is compiled out and a level disabled at runtime skips the arguments too.
+*/
+#define LOG_AT(level, ...)                                  \
+    do                                                      \
+    {                                                       \
+        if constexpr (LOG_COMPILED(level))                  \
+        {                                                   \
+            if (log_enabled(level))                         \
+            {                                               \
+                log::write(level, __VA_ARGS__);             \
+            }                                               \
+        }                                                   \
+    } while (0)
+
+#define LOG_TRACE(...)   LOG_AT(Log_Trace, __VA_ARGS__)
+#define LOG_DEBUG(...)   LOG_AT(Log_Debug, __VA_ARGS__)
+#define LOG_INFO(...)    LOG_AT(Log_Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(Log_Warning, __VA_ARGS__)
+#define LOG_ERROR(...)   LOG_AT(Log_Error, __VA_ARGS__)
+
+// at most 'per_second' messages per second from this call site
+#define LOG_RATE_LIMITED(level, per_second, ...)                                                            \
+    do                                                                                                      \
+    {                                                                                                       \
+        if constexpr (LOG_COMPILED(level))                                                                  \
+        {                                                                                                   \
+            static Log_Rate_Limit logRateLimit;                                                             \
+            u32                   logSuppressed = 0;                                                        \
+                                                                                                            \
+            if (log_enabled(level) && logRateLimit.allow(per_second, logSuppressed))                        \
+            {                                                                                               \
+                if (logSuppressed)                                                                          \
+                {                                                                                           \
+                    log::write(level, "/% messages suppressed at /%:/%\n", logSuppressed, __FILE__, __LINE__); \
+                }                                                                                           \
+                log::write(level, __VA_ARGS__);                                                             \
+            }                                                                                               \
+        }                                                                                                   \
+    } while (0)
+
 #endif /*LOG_H_*/
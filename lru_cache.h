@@ -1,8 +1,44 @@
+#ifndef LRU_CACHE_H_
+#define LRU_CACHE_H_
 
+// untested
 
-untested
+#include "typedefs.h"
+#include "metrics.h"
 
+// set to 0 to compile the counters out of every cache
+#ifndef LRU_CACHE_STATS
+#define LRU_CACHE_STATS 1
+#endif
 
+#if LRU_CACHE_STATS
+#define LRU_STAT(x) x
+#else
+#define LRU_STAT(x)
+#endif
+
+struct Cache_Stats {
+    u64 hits      = 0;
+    u64 misses    = 0;
+    u64 evictions = 0;
+    u64 inserts   = 0;
+    u64 bytes     = 0; // payload bytes of the live entries
+
+    f64 hit_ratio() const {
+        u64 lookups = hits + misses;
+        return lookups ? f64(hits) / f64(lookups) : 0.0;
+    }
+};
+
+// the same numbers as metrics.h counters, for caches that are watched at runtime
+struct Cache_Metrics {
+    bool      published = false;
+    Metric_Id hits;
+    Metric_Id misses;
+    Metric_Id evictions;
+    Metric_Id inserts;
+    Metric_Id bytes;
+};
 
 template <typename Key_Type, typename Item_Type>
 struct LRU_Cache {
@@ -10,25 +46,61 @@ struct LRU_Cache {
     using Map_Type     = std::map<Key_Type, std::pair<Item_Type, typename std::list<Key_Type>::iterator>>;
     using Map_Iterator = typename Map_Type::iterator;
 
-    i32       cache_size;
-    Map_Type  cache_map;
-    List_Type cache_list;
+    static constexpr u64 entry_bytes = sizeof(Key_Type) + sizeof(Item_Type);
+
+    i32           cache_size;
+    Map_Type      cache_map;
+    List_Type     cache_list;
+    Cache_Stats   stats;
+    Cache_Metrics metrics;
 
     LRU_Cache(i32 size) : cache_size(size) {
         cache_size = size;
     }
 
+    // "<name>_hits", "<name>_misses", ... counters and a "<name>_bytes" gauge
+    void publish_metrics(const char *name) {
+        std::string prefix = name;
+
+        metrics.hits      = metric_counter((prefix + "_hits").c_str());
+        metrics.misses    = metric_counter((prefix + "_misses").c_str());
+        metrics.evictions = metric_counter((prefix + "_evictions").c_str());
+        metrics.inserts   = metric_counter((prefix + "_inserts").c_str());
+        metrics.bytes     = metric_gauge((prefix + "_bytes").c_str());
+        metrics.published = true;
+        metric_set(metrics.bytes, i64(stats.bytes));
+    }
+
+    void count(Metric_Id counter) {
+        if (metrics.published) {
+            metric_add(counter);
+        }
+    }
+
+    void publish_bytes() {
+        if (metrics.published) {
+            metric_set(metrics.bytes, i64(stats.bytes));
+        }
+    }
+
     void insert(const Key_Type &key, const Item_Type &item) {
         Map_Iterator cache_entry = cache_map.find(key);
 
+        LRU_STAT(stats.inserts++);
+        LRU_STAT(count(metrics.inserts));
         if (cache_entry == cache_map.end()) {
             cache_list.push_front(key);
             cache_map[key] = {item, cache_list.begin()};
+            LRU_STAT(stats.bytes += entry_bytes);
 
             if (cache_list.size() > cache_size) {
                 cache_map.erase(cache_list.back());
                 cache_list.pop_back();
+                LRU_STAT(stats.evictions++);
+                LRU_STAT(stats.bytes -= entry_bytes);
+                LRU_STAT(count(metrics.evictions));
             }
+            LRU_STAT(publish_bytes());
         } else {
             cache_list.erase((*cache_entry).second.second);
             cache_list.push_front(key);
@@ -40,13 +112,32 @@ struct LRU_Cache {
         Map_Iterator cache_entry = cache_map.find(key);
 
         if (cache_entry == cache_map.end()) {
+            LRU_STAT(stats.misses++);
+            LRU_STAT(count(metrics.misses));
             return false;
         }
 
+        LRU_STAT(stats.hits++);
+        LRU_STAT(count(metrics.hits));
         item = (*cache_entry).second.first;
         cache_list.erase((*cache_entry).second.second);
         cache_list.push_front(key);
         (*cache_entry).second.second = cache_list.begin();
         return true;
     }
+
+    void clear() {
+        cache_map.clear();
+        cache_list.clear();
+        stats = {};
+        publish_bytes();
+    }
+
+    void reset_stats() {
+        u64 bytes   = stats.bytes;
+        stats       = {};
+        stats.bytes = bytes;
+    }
 };
+
+#endif
@@ -2,34 +2,57 @@
 #include "memory.h"
 
 #define LOG_MEM_ALLOC 0
+// per thread counter of operator new calls, for the allocations per op numbers in the benchmarks.
+// A TLS increment in every new, so only benchmark builds turn it on (-DCOUNT_MEM_ALLOC=1)
+#ifndef COUNT_MEM_ALLOC
+#define COUNT_MEM_ALLOC 0
+#endif
+
+#if COUNT_MEM_ALLOC
+static thread_local u64 alloc_count = 0;
+#endif
+
+u64 mem_alloc_count() {
+#if COUNT_MEM_ALLOC
+    return alloc_count;
+#else
+    return 0;
+#endif
+}
 
 void *operator new(std::size_t sz) {
+#if COUNT_MEM_ALLOC
+    alloc_count++;
+#endif
 #if LOG_MEM_ALLOC
     char tmp[256];
     std::sprintf(tmp, "[MEM] new called, size = %d\n", (int)sz);
-    OutputDebugStringA(tmp);
+    platform_debug_output(tmp);
 #endif
 
     return std::malloc(sz);
 }
 void operator delete(void *ptr) noexcept {
 #if LOG_MEM_ALLOC
-    OutputDebugStringA("[MEM] delete called\n");
+    platform_debug_output("[MEM] delete called\n");
 #endif
     std::free(ptr);
 }
 
 void *operator new[](std::size_t sz) {
+#if COUNT_MEM_ALLOC
+    alloc_count++;
+#endif
 #if LOG_MEM_ALLOC
     char tmp[256];
     std::sprintf(tmp, "[MEM] new[] called, size = %d\n", (int)sz);
-    OutputDebugStringA(tmp);
+    platform_debug_output(tmp);
 #endif
     return std::malloc(sz);
 }
 void operator delete[](void *ptr) noexcept {
 #if LOG_MEM_ALLOC
-    OutputDebugStringA("[MEM] delete[] called\n");
+    platform_debug_output("[MEM] delete[] called\n");
 #endif
     std::free(ptr);
 }
@@ -3,7 +3,8 @@
 
 #include "util.h"
 #include "typedefs.h"
-#include <Windows.h>
+#include "stringfmt.h"
+#include "metrics.h"
 
 /*
 ===============================================================================
@@ -22,6 +23,9 @@
                        destructors never get called. The frame_allocator is a
                        linear_allocator.
 
+     Both publish their occupancy as metrics.h gauges, "<name>_items" and
+     "<name>_used_bytes", allocators with the same name add up.
+
 ===============================================================================
 */
 
@@ -42,6 +46,7 @@ struct Block_Allocator {
     i32               index;
     i8 *              allocator_name;
     Linear_Allocator *linear_allocator;
+    Metric_Id         items_metric;
 
     void set_name(i8 *str) {
         allocator_name = str;
@@ -52,6 +57,7 @@ struct Block_Allocator {
         linear_allocator = allocator;
         buffer           = (Item_Type *)linear_allocator->alloc(sizeof(Item_Type) * block_size);
         index            = 0;
+        items_metric     = metric_gauge((std::string(name) + "_items").c_str());
         for (i32 i = 0; i < block_size; i++) {
             free_list[i] = &buffer[i];
         }
@@ -77,7 +83,7 @@ bool Block_Allocator<Item_Type, block_size>::empty() {
 template <typename Item_Type, i32 block_size>
 Item_Type *Block_Allocator<Item_Type, block_size>::alloc() {
     if (full()) {
-        panic(stringf("'%s' block_allocator is full", allocator_name));
+        Panic(stringf("'/%' block_allocator is full", allocator_name));
         return NULL;
     }
 
@@ -85,6 +91,7 @@ Item_Type *Block_Allocator<Item_Type, block_size>::alloc() {
 
     // move to the next slot
     index++;
+    metric_adjust(items_metric, 1);
 
     return memory_slot;
 }
@@ -94,6 +101,7 @@ void Block_Allocator<Item_Type, block_size>::free(Item_Type *object) {
     object->~Item_Type();
     index--;
     free_list[index] = object;
+    metric_adjust(items_metric, -1);
 }
 
 template <typename Item_Type, i32 block_size>
@@ -107,12 +115,14 @@ struct Linear_Allocator {
     i32               allocated_bytes;
     i8 *              allocator_name;
     Linear_Allocator *parent_allocator;
+    Metric_Id         used_metric;
 
     void init(i32 size, Linear_Allocator *parent, const i8 *name) {
         parent_allocator = parent;
         allocator_name   = (i8 *)name;
         arena_size       = size;
         allocated_bytes  = 0;
+        used_metric      = metric_gauge((std::string(name) + "_used_bytes").c_str());
 
         if (parent_allocator == NULL) {
             // this is the global_arena
@@ -134,12 +144,14 @@ struct Linear_Allocator {
         allocated_bytes += bytes;
         start = start + bytes;
         if (allocated_bytes > arena_size) {
-            panic(stringf("%s failed to allocate %d bytes", allocator_name, bytes));
+            Panic(stringf("/% failed to allocate /% bytes", allocator_name, bytes));
         }
+        metric_adjust(used_metric, bytes);
         return result;
     }
 
     void reset() {
+        metric_adjust(used_metric, -allocated_bytes);
         start           = arena;
         allocated_bytes = 0;
     }
@@ -154,6 +166,9 @@ struct Memory_Manager {
 
 Memory_Manager *get_memory_manager();
 
+// operator new calls made by the calling thread so far, 0 when COUNT_MEM_ALLOC is off in memory.cpp
+u64 mem_alloc_count();
+
 //
 // Memory will be deallocated in the next frame. The frame allocator doesnt call the destructors.
 //
@@ -165,7 +180,7 @@ Item_Type *create_temporary_object(const i32 num_objects) {
     p                        = round_up(p, 16);
 
     if (((uintptr_t)p % 16) != 0) {
-        panic("misalligned memory allocation");
+        Panic("misalligned memory allocation");
     }
 
     Item_Type *obj = new ((void *)p) Item_Type[num_objects];
@@ -180,7 +195,7 @@ Item_Type *create_object(i32 num_objects) {
     p                        = round_up(p, 16);
 
     if (((uintptr_t)p % 16) != 0) {
-        panic("misalligned memory allocation");
+        Panic("misalligned memory allocation");
     }
 
     Item_Type *obj = new ((void *)p) Item_Type[num_objects];
@@ -0,0 +1,366 @@
+#include "metrics.h"
+#include "histogram.h"
+#include "util.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <ctype.h>
+#include <filesystem>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+struct Metric_Entry {
+    std::string name; // written once before entry_count publishes it
+    Metric_Kind kind;
+};
+
+// gives the shard back when the thread exits, its counts stay and the next owner adds to them
+struct Metric_Shard_Owner {
+    Metric_Shard *shard = NULL;
+
+    ~Metric_Shard_Owner() {
+        if (shard) {
+            metric_shard = NULL;
+            shard->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+struct Metrics_Exporter {
+    Metrics_Export_Config   config;
+    std::string             file_name;
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable wake;
+    bool                    running;
+    Platform_Socket         listener;
+
+    // cumulative snapshots of the last export, the quantiles are over the difference
+    Histogram_Snapshot     *previous[Histogram_Max_Named];
+
+    // a joinable thread would terminate the process at exit
+    ~Metrics_Exporter() {
+        metrics_export_stop();
+    }
+};
+
+Metric_Gauge_Cell metric_gauges[Metric_Max];
+
+static std::mutex                      metrics_mutex;
+static Metric_Entry                    entries[Metric_Max];
+static std::atomic<u32>                entry_count;
+static std::atomic<Metric_Shard *>     shards;
+static thread_local Metric_Shard_Owner shard_owner;
+static Metrics_Exporter                exporter;
+
+// every metric past the limit writes into the last cell, it's never exported
+static const Metric_Id metric_overflow = Metric_Max - 1;
+
+static Metric_Id metric_register(const char *name, Metric_Kind kind) {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+
+    u32 count = entry_count.load(std::memory_order_relaxed);
+
+    for (u32 i = 0; i < count; i++) {
+        if (entries[i].name == name) {
+            if (entries[i].kind != kind) {
+                Panic(StringF("metric '%s' is registered as a counter and as a gauge", name));
+            }
+            return i;
+        }
+    }
+
+    if (count == metric_overflow) {
+        static bool reported = false;
+        if (!reported) {
+            report("metric_register: more than %u metrics, '%s' and later ones aren't exported, raise Metric_Max\n",
+                   metric_overflow, name);
+            reported = true;
+        }
+        return metric_overflow;
+    }
+
+    entries[count].name = name;
+    entries[count].kind = kind;
+    entry_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+Metric_Id metric_counter(const char *name) {
+    return metric_register(name, Metric_Counter);
+}
+
+Metric_Id metric_gauge(const char *name) {
+    return metric_register(name, Metric_Gauge);
+}
+
+Metric_Shard *metric_acquire_shard() {
+    std::lock_guard<std::mutex> lock(metrics_mutex);
+
+    Metric_Shard *shard = NULL;
+
+    for (Metric_Shard *it = shards.load(std::memory_order_acquire); it; it = it->next) {
+        bool expected = false;
+
+        if (it->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            shard = it;
+            break;
+        }
+    }
+
+    if (!shard) {
+        shard = new Metric_Shard();
+        shard->in_use.store(true, std::memory_order_relaxed);
+        shard->next = shards.load(std::memory_order_relaxed);
+        shards.store(shard, std::memory_order_release);
+    }
+
+    shard_owner.shard = shard;
+    metric_shard      = shard;
+    return shard;
+}
+
+u32 metric_count() {
+    return entry_count.load(std::memory_order_acquire);
+}
+
+const char *metric_name(Metric_Id id) {
+    return entries[id].name.c_str();
+}
+
+Metric_Kind metric_kind(Metric_Id id) {
+    return entries[id].kind;
+}
+
+i64 metric_value(Metric_Id id) {
+    u64 sum = 0;
+    for (Metric_Shard *shard = shards.load(std::memory_order_acquire); shard; shard = shard->next) {
+        sum += shard->cells[id].load(std::memory_order_relaxed);
+    }
+
+    if (entries[id].kind == Metric_Gauge) {
+        return metric_gauges[id].value.load(std::memory_order_relaxed) + i64(sum);
+    }
+
+    return i64(sum);
+}
+
+/*
+===============================================================================
+    text exposition format
+===============================================================================
+*/
+
+// metric names are [a-zA-Z_:][a-zA-Z0-9_:]*
+static std::string exposition_name(const char *name, const char *suffix) {
+    std::string out = name;
+
+    for (u64 i = 0; i < out.size(); i++) {
+        char c = out[i];
+
+        if (!(isalpha(u8(c)) || c == '_' || c == ':' || (i > 0 && isdigit(u8(c))))) {
+            out[i] = '_';
+        }
+    }
+
+    return out + suffix;
+}
+
+static void format_histogram(const char *name, const Histogram_Snapshot &total, const Histogram_Snapshot &quantiles, std::string &out) {
+    static const f64   percentiles[] = {50.0, 99.0, 99.9};
+    static const char *labels[]      = {"0.5", "0.99", "0.999", "1"};
+
+    std::string metric = exposition_name(name, "_ns");
+
+    out += StringF("# TYPE %s summary\n", metric.c_str());
+    for (u32 i = 0; i < 4; i++) {
+        // nothing recorded in the interval
+        if (quantiles.count == 0) {
+            out += StringF("%s{quantile=\"%s\"} NaN\n", metric.c_str(), labels[i]);
+        } else {
+            u64 value = i < 3 ? histogram_percentile(quantiles, percentiles[i]) : quantiles.max;
+            out += StringF("%s{quantile=\"%s\"} %llu\n", metric.c_str(), labels[i], (unsigned long long)value);
+        }
+    }
+    out += StringF("%s_sum %llu\n", metric.c_str(), (unsigned long long)total.sum);
+    out += StringF("%s_count %llu\n", metric.c_str(), (unsigned long long)total.count);
+}
+
+// previous: the snapshots of the last call, NULL for quantiles over the whole lifetime
+static std::string format_metrics(Histogram_Snapshot **previous) {
+    std::string out;
+
+    for (Metric_Id id = 0; id < metric_count(); id++) {
+        std::string name = exposition_name(metric_name(id), "");
+
+        out += StringF("# TYPE %s %s\n", name.c_str(), metric_kind(id) == Metric_Counter ? "counter" : "gauge");
+        out += StringF("%s %lld\n", name.c_str(), (long long)metric_value(id));
+    }
+
+    // ~15k each, too much for the stack
+    Histogram_Snapshot *total    = new Histogram_Snapshot;
+    Histogram_Snapshot *interval = new Histogram_Snapshot;
+
+    for (Histogram_Id id = 0; id < histogram_count(); id++) {
+        histogram_snapshot(id, *total);
+
+        if (!previous) {
+            format_histogram(histogram_name(id), *total, *total, out);
+            continue;
+        }
+
+        if (!previous[id]) {
+            previous[id] = new Histogram_Snapshot();
+        }
+
+        memcpy(interval, total, sizeof(Histogram_Snapshot));
+        histogram_subtract(*interval, *previous[id]);
+        memcpy(previous[id], total, sizeof(Histogram_Snapshot));
+
+        format_histogram(histogram_name(id), *total, *interval, out);
+    }
+
+    delete total;
+    delete interval;
+    return out;
+}
+
+std::string metrics_format() {
+    return format_metrics(NULL);
+}
+
+/*
+===============================================================================
+    export thread
+===============================================================================
+*/
+
+static void write_export_file(const std::string &text) {
+    std::string temp_name = exporter.file_name + ".tmp";
+    FILE       *file      = fopen(temp_name.c_str(), "wb");
+
+    if (!file) {
+        REPORT(Log_Warning, "metrics: can't open %s\n", temp_name.c_str());
+        return;
+    }
+
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    fclose(file);
+
+    // readers never see a half written file
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temp_name, exporter.file_name, error);
+    }
+    if (!written || error) {
+        std::filesystem::remove(temp_name, error);
+    }
+}
+
+static void serve_connection(Platform_Socket client, const std::string &text) {
+    char request[1024];
+
+    // the request doesn't matter, read it so closing doesn't reset the connection
+    platform_recv(client, request, sizeof(request), 100);
+
+    std::string response = StringF("HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: %llu\r\n"
+                                   "Connection: close\r\n\r\n",
+                                   (unsigned long long)text.size());
+
+    response += text;
+    platform_send(client, response.data(), response.size(), 1000);
+    platform_close_socket(client);
+}
+
+static void exporter_entrypoint() {
+    using Clock = std::chrono::steady_clock;
+
+    platform_set_thread_name("metrics_export");
+
+    auto        interval    = std::chrono::milliseconds(exporter.config.interval_ms);
+    auto        next_export = Clock::now();
+    std::string text;
+
+    while (true) {
+        auto now = Clock::now();
+
+        if (now >= next_export) {
+            text = format_metrics(exporter.previous);
+            if (exporter.config.file_name) {
+                write_export_file(text);
+            }
+            next_export = now + interval;
+        }
+
+        u32 wait_ms = u32(std::chrono::duration_cast<std::chrono::milliseconds>(next_export - now).count());
+
+        if (exporter.listener != Platform_Invalid_Socket) {
+            // short waits so metrics_export_stop doesn't wait for a whole interval
+            Platform_Socket client = platform_accept(exporter.listener, wait_ms < 100 ? wait_ms : 100);
+
+            if (client != Platform_Invalid_Socket) {
+                serve_connection(client, text);
+            }
+
+            std::lock_guard<std::mutex> lock(exporter.mutex);
+            if (!exporter.running) {
+                break;
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(exporter.mutex);
+
+            if (exporter.wake.wait_for(lock, std::chrono::milliseconds(wait_ms), [] { return !exporter.running; })) {
+                break;
+            }
+        }
+    }
+
+    // the final values
+    if (exporter.config.file_name) {
+        write_export_file(format_metrics(exporter.previous));
+    }
+}
+
+void metrics_export_start(const Metrics_Export_Config &config) {
+    metrics_export_stop();
+
+    exporter.config   = config;
+    exporter.listener = Platform_Invalid_Socket;
+
+    if (config.file_name) {
+        exporter.file_name = config.file_name;
+    }
+
+    if (config.port) {
+        exporter.listener = platform_listen_local(uint16_t(config.port));
+
+        if (exporter.listener == Platform_Invalid_Socket) {
+            report("metrics: can't listen on 127.0.0.1:%u\n", config.port);
+        }
+    }
+
+    exporter.running = true;
+    exporter.thread  = std::thread(exporter_entrypoint);
+}
+
+void metrics_export_stop() {
+    {
+        std::lock_guard<std::mutex> lock(exporter.mutex);
+
+        if (!exporter.running) {
+            return;
+        }
+        exporter.running = false;
+    }
+
+    exporter.wake.notify_one();
+    exporter.thread.join();
+
+    if (exporter.listener != Platform_Invalid_Socket) {
+        platform_close_socket(exporter.listener);
+        exporter.listener = Platform_Invalid_Socket;
+    }
+}
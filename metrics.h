@@ -0,0 +1,106 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "typedefs.h"
+
+/*
+===============================================================================
+
+    Runtime metrics: named counters and gauges, exported with the histogram.h
+    latency histograms.
+
+        static const Metric_Id tokens = metric_counter("lexer_tokens");
+        metric_add(tokens, token_count);
+
+        static const Metric_Id queued = metric_gauge("worker_parallel_queued");
+        metric_adjust(queued, 1);
+
+    Counters only go up. Every thread adds into its own shard, a row of
+    cells only that thread writes, so metric_add is a thread_local lookup, a
+    relaxed load and a relaxed store - no lock, no locked instruction, no
+    shared cache line. Reading a counter adds up the shards.
+
+    Gauges are a current value (bytes in use, queue length). metric_set
+    stores into one atomic per gauge on its own cache line. metric_adjust
+    adds into the shard of the thread like a counter, so everything that
+    adjusts a gauge of the same name (every allocator called "frame") adds
+    up and an update never touches a shared cache line. The value is the
+    stored value plus all adjustments.
+
+    metrics_export_start runs a thread that every interval_ms renders all
+    metrics in the Prometheus text exposition format, writes them to a file
+    (replaced in one step) and answers every connection on 127.0.0.1:port
+    with the latest text. Histogram quantiles are over the last interval,
+    _sum and _count over the lifetime of the process. The export stops by
+    itself (one last file) when the program exits without
+    metrics_export_stop.
+
+===============================================================================
+*/
+
+static const u32 Metric_Max = 256;
+
+enum Metric_Kind {
+    Metric_Counter,
+    Metric_Gauge,
+};
+
+using Metric_Id = u32;
+
+struct Metric_Shard {
+    std::atomic<u64>  cells[Metric_Max];
+    std::atomic<bool> in_use;
+    Metric_Shard     *next;
+};
+
+struct alignas(64) Metric_Gauge_Cell {
+    std::atomic<i64> value;
+};
+
+struct Metrics_Export_Config {
+    const char *file_name   = NULL; // NULL - no file
+    u32         port        = 0;    // 0 - no socket
+    u32         interval_ms = 1000;
+};
+
+// the name is copied, registering a name again gives the same id. Past Metric_Max metrics
+// every new name gets one shared id that isn't exported (reported once).
+Metric_Id          metric_counter(const char *name);
+Metric_Id          metric_gauge(const char *name);
+
+Metric_Shard      *metric_acquire_shard();
+
+inline thread_local Metric_Shard *metric_shard = NULL;
+extern Metric_Gauge_Cell          metric_gauges[Metric_Max];
+
+inline void metric_add(Metric_Id id, u64 count = 1) {
+    Metric_Shard     *shard = metric_shard ? metric_shard : metric_acquire_shard();
+    std::atomic<u64> &cell  = shard->cells[id];
+
+    // only this thread writes the cell, the reader just needs untorn values
+    cell.store(cell.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+inline void metric_set(Metric_Id id, i64 value) {
+    metric_gauges[id].value.store(value, std::memory_order_relaxed);
+}
+
+// the cells of a gauge hold the sum of its adjustments, negative ones wrap around
+inline void metric_adjust(Metric_Id id, i64 delta) {
+    metric_add(id, u64(delta));
+}
+
+u32                metric_count();
+const char        *metric_name(Metric_Id id);
+Metric_Kind        metric_kind(Metric_Id id);
+
+// counters: the sum of the shards, gauges: the stored value plus the sum of the shards
+i64                metric_value(Metric_Id id);
+
+// every metric and histogram in the text exposition format, quantiles over the whole lifetime
+std::string        metrics_format();
+
+void               metrics_export_start(const Metrics_Export_Config &config);
+void               metrics_export_stop();
+
+#endif
@@ -0,0 +1,260 @@
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+void *platform_aligned_alloc(size_t size, size_t alignment) {
+    return _aligned_malloc(size, alignment);
+}
+
+void platform_aligned_free(void *memory) {
+    _aligned_free(memory);
+}
+
+bool platform_sync_file(FILE *file) {
+    return fflush(file) == 0 && _commit(_fileno(file)) == 0;
+}
+
+void platform_debug_output(const char *text) {
+    static bool debugger_present = !!IsDebuggerPresent();
+
+    if (debugger_present) {
+        OutputDebugStringA(text);
+    }
+}
+
+void platform_error_box(const char *title, const char *text) {
+    MessageBoxA(0, text, title, MB_OK + MB_ICONERROR);
+}
+
+void platform_exit(int exit_code) {
+    ExitProcess(exit_code);
+}
+
+void platform_set_thread_name(const char *name) {
+    wchar_t wide_name[64];
+    int     length = MultiByteToWideChar(CP_UTF8, 0, name, -1, wide_name, 64);
+
+    if (length > 0) {
+        SetThreadDescription(GetCurrentThread(), wide_name);
+    }
+}
+
+void platform_set_thread_low_priority() {
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+}
+
+static bool wait_readable(SOCKET socket, uint32_t timeout_ms) {
+    fd_set  readable;
+    timeval timeout = {long(timeout_ms / 1000), long(timeout_ms % 1000) * 1000};
+
+    FD_ZERO(&readable);
+    FD_SET(socket, &readable);
+    return select(0, &readable, NULL, NULL, &timeout) > 0;
+}
+
+Platform_Socket platform_listen_local(uint16_t port) {
+    static bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+
+    if (!started) {
+        return Platform_Invalid_Socket;
+    }
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        return Platform_Invalid_Socket;
+    }
+
+    sockaddr_in address     = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 8) != 0) {
+        closesocket(listener);
+        return Platform_Invalid_Socket;
+    }
+
+    return Platform_Socket(listener);
+}
+
+Platform_Socket platform_accept(Platform_Socket listener, uint32_t timeout_ms) {
+    if (!wait_readable(SOCKET(listener), timeout_ms)) {
+        return Platform_Invalid_Socket;
+    }
+
+    SOCKET client = accept(SOCKET(listener), NULL, NULL);
+    return client == INVALID_SOCKET ? Platform_Invalid_Socket : Platform_Socket(client);
+}
+
+int64_t platform_recv(Platform_Socket socket, void *buffer, size_t size, uint32_t timeout_ms) {
+    if (!wait_readable(SOCKET(socket), timeout_ms)) {
+        return 0;
+    }
+
+    int received = recv(SOCKET(socket), (char *)buffer, int(size), 0);
+    return received == SOCKET_ERROR ? -1 : received;
+}
+
+bool platform_send(Platform_Socket socket, const void *data, size_t size, uint32_t timeout_ms) {
+    const char *bytes   = (const char *)data;
+    DWORD       timeout = timeout_ms;
+
+    // a blocking send only returns once everything is queued, a client that doesn't read would hang it
+    setsockopt(SOCKET(socket), SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+    while (size) {
+        int sent = send(SOCKET(socket), bytes, int(size), 0);
+        if (sent == SOCKET_ERROR) {
+            return false;
+        }
+        bytes += sent;
+        size -= size_t(sent);
+    }
+
+    return true;
+}
+
+void platform_close_socket(Platform_Socket socket) {
+    closesocket(SOCKET(socket));
+}
+
+#else
+
+void *platform_aligned_alloc(size_t size, size_t alignment) {
+    void *memory = NULL;
+
+    // posix_memalign wants at least pointer alignment
+    if (alignment < sizeof(void *)) {
+        alignment = sizeof(void *);
+    }
+
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+}
+
+void platform_aligned_free(void *memory) {
+    free(memory);
+}
+
+bool platform_sync_file(FILE *file) {
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+void platform_debug_output(const char *text) {
+    fputs(text, stderr);
+}
+
+void platform_error_box(const char *title, const char *text) {
+    fprintf(stderr, "\n%s: %s\n", title, text);
+}
+
+void platform_exit(int exit_code) {
+    // like ExitProcess, no static destructors
+    fflush(NULL);
+    _exit(exit_code);
+}
+
+void platform_set_thread_name(const char *name) {
+    char short_name[16];
+
+    strncpy(short_name, name, sizeof(short_name) - 1);
+    short_name[sizeof(short_name) - 1] = 0;
+    pthread_setname_np(pthread_self(), short_name);
+}
+
+// nice 10 rather than SCHED_IDLE, an idle thread gets nothing while the machine is busy and the
+// pool would starve on a loaded server. The nice value is per thread on Linux, 0 is the caller
+void platform_set_thread_low_priority() {
+    setpriority(PRIO_PROCESS, 0, 10);
+}
+
+static bool wait_readable(int socket, uint32_t timeout_ms) {
+    pollfd poll_fd = {socket, POLLIN, 0};
+    return poll(&poll_fd, 1, int(timeout_ms)) > 0;
+}
+
+Platform_Socket platform_listen_local(uint16_t port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return Platform_Invalid_Socket;
+    }
+
+    // restarting the process shouldn't wait for the old connections to time out
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address     = {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 8) != 0) {
+        close(listener);
+        return Platform_Invalid_Socket;
+    }
+
+    return listener;
+}
+
+Platform_Socket platform_accept(Platform_Socket listener, uint32_t timeout_ms) {
+    if (!wait_readable(int(listener), timeout_ms)) {
+        return Platform_Invalid_Socket;
+    }
+
+    int client = accept(int(listener), NULL, NULL);
+    return client < 0 ? Platform_Invalid_Socket : client;
+}
+
+int64_t platform_recv(Platform_Socket socket, void *buffer, size_t size, uint32_t timeout_ms) {
+    if (!wait_readable(int(socket), timeout_ms)) {
+        return 0;
+    }
+
+    return recv(int(socket), buffer, size, 0);
+}
+
+bool platform_send(Platform_Socket socket, const void *data, size_t size, uint32_t timeout_ms) {
+    const char *bytes   = (const char *)data;
+    timeval     timeout = {time_t(timeout_ms / 1000), suseconds_t(timeout_ms % 1000) * 1000};
+
+    // a blocking send only returns once everything is queued, a client that doesn't read would hang it
+    setsockopt(int(socket), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    while (size) {
+        // no SIGPIPE when the reader is gone
+        ssize_t sent = send(int(socket), bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= size_t(sent);
+    }
+
+    return true;
+}
+
+void platform_close_socket(Platform_Socket socket) {
+    close(int(socket));
+}
+
+#endif
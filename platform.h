@@ -0,0 +1,95 @@
+#ifndef PLATFORM_H_
+#define PLATFORM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+// every file gets this through typedefs.h, keep min / max and the rarely used headers out
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+/*
+===============================================================================
+
+    The few OS calls the rest of the code needs, for Windows and Linux.
+
+    Everything else includes this instead of <Windows.h>. It only uses the
+    standard integer types because typedefs.h itself depends on it.
+
+        timing:   platform_ticks, QueryPerformanceCounter / CLOCK_MONOTONIC
+        output:   platform_debug_output, the debugger if one is attached on
+                  Windows, stderr on Linux
+        failure:  platform_error_box, platform_exit
+        threads:  platform_set_thread_name, platform_set_thread_low_priority
+        memory:   platform_aligned_alloc
+        files:    platform_sync_file
+        sockets:  platform_listen_local, blocking TCP on 127.0.0.1 only
+
+===============================================================================
+*/
+
+inline int64_t platform_ticks() {
+#ifdef _WIN32
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+inline int64_t platform_ticks_per_second() {
+#ifdef _WIN32
+    static const int64_t frequency = [] {
+        LARGE_INTEGER ticks;
+        QueryPerformanceFrequency(&ticks);
+        return int64_t(ticks.QuadPart);
+    }();
+    return frequency;
+#else
+    return 1000000000;
+#endif
+}
+
+void *platform_aligned_alloc(size_t size, size_t alignment);
+void  platform_aligned_free(void *memory);
+
+// fflush and then fsync / _commit, true once the data is on the disk
+bool  platform_sync_file(FILE *file);
+
+void  platform_debug_output(const char *text);
+void  platform_error_box(const char *title, const char *text);
+[[noreturn]] void platform_exit(int exit_code);
+
+// Linux keeps only the first 15 characters
+void  platform_set_thread_name(const char *name);
+void  platform_set_thread_low_priority();
+
+// a SOCKET or a file descriptor
+using Platform_Socket = int64_t;
+
+static const Platform_Socket Platform_Invalid_Socket = -1;
+
+// listens on 127.0.0.1:port, Platform_Invalid_Socket if the port is taken
+Platform_Socket platform_listen_local(uint16_t port);
+// Platform_Invalid_Socket if nobody connected within timeout_ms
+Platform_Socket platform_accept(Platform_Socket listener, uint32_t timeout_ms);
+// bytes received, 0 if nothing arrived within timeout_ms or the other side closed, -1 on error
+int64_t         platform_recv(Platform_Socket socket, void *buffer, size_t size, uint32_t timeout_ms);
+// false if the connection broke or the other side took nothing for timeout_ms before everything was sent
+bool            platform_send(Platform_Socket socket, const void *data, size_t size, uint32_t timeout_ms);
+void            platform_close_socket(Platform_Socket socket);
+
+#endif
@@ -0,0 +1,295 @@
+#include "profiler.h"
+#include "histogram.h"
+#include "util.h"
+
+#include <mutex>
+#include <string.h>
+
+// events per thread, a frame can't record more zones than half of this on one thread
+static const u64 Profile_Ring_Events = 1 << 15;
+
+struct Profile_Node {
+    const char *name;
+    i32         parent;
+    i32         first_child;
+    i32         next_sibling;
+
+    u64         frame_ticks;
+    u64         frame_child_ticks;
+    u64         frame_count;
+
+    u64         total_ticks;
+    u64         total_child_ticks;
+    u64         total_count;
+
+    Latency_Histogram *histogram; // of every call, for the percentiles
+};
+
+struct Profile_Open_Zone {
+    i32 node;
+    u64 begin_ticks;
+};
+
+// nodes[0] is the thread itself, its time is the sum of the top level zones
+struct Profile_Tree {
+    Array_Of<Profile_Node>      nodes;
+    Array_Of<Profile_Open_Zone> open_zones;
+};
+
+struct Profile_Ring_Owner {
+    Profile_Ring *ring = NULL;
+
+    ~Profile_Ring_Owner() {
+        if (ring) {
+            profiler_ring = NULL;
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static std::mutex                      profiler_mutex;
+static std::atomic<Profile_Ring *>     rings;
+static u32                             ring_count;
+static Array_Of<Profile_Tree>          trees;
+static u64                             frames;
+static u64                             frame_start_ticks = timer_ticks();
+static u64                             last_frame_ticks;
+static thread_local Profile_Ring_Owner ring_owner;
+
+Profile_Ring *profiler_acquire_ring() {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    Profile_Ring *ring = NULL;
+
+    for (Profile_Ring *it = rings.load(std::memory_order_acquire); it; it = it->next) {
+        bool expected = false;
+
+        if (it->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            ring = it;
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring         = new Profile_Ring();
+        ring->events = new Profile_Event[Profile_Ring_Events];
+        ring->size   = Profile_Ring_Events;
+        ring->index  = ring_count++;
+        ring->write_pos.store(0, std::memory_order_relaxed);
+        ring->read_pos.store(0, std::memory_order_relaxed);
+        ring->dropped.store(0, std::memory_order_relaxed);
+        ring->in_use.store(true, std::memory_order_relaxed);
+        ring->next = rings.load(std::memory_order_relaxed);
+        rings.store(ring, std::memory_order_release);
+    }
+
+    ring->cached_read_pos = ring->read_pos.load(std::memory_order_acquire);
+    ring->open_depth      = 0;
+    ring->skip_depth      = 0;
+    snprintf(ring->thread_name, sizeof(ring->thread_name), "thread %u", ring->index);
+
+    ring_owner.ring = ring;
+    profiler_ring   = ring;
+    return ring;
+}
+
+void profiler_set_thread_name(const char *name) {
+    Profile_Ring *ring = profiler_ring ? profiler_ring : profiler_acquire_ring();
+
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+    snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", name);
+}
+
+static i32 find_child(Profile_Tree &tree, i32 parent, const char *name) {
+    i32 last_child = -1;
+
+    for (i32 child = tree.nodes[parent].first_child; child >= 0; child = tree.nodes[child].next_sibling) {
+        const char *child_name = tree.nodes[child].name;
+
+        // the same literal usually has the same address, strcmp for the ones that don't
+        if (child_name == name || strcmp(child_name, name) == 0) {
+            return child;
+        }
+        last_child = child;
+    }
+
+    Profile_Node node = {};
+    node.name         = name;
+    node.parent       = parent;
+    node.first_child  = -1;
+    node.next_sibling = -1;
+    node.histogram    = new Latency_Histogram();
+
+    // children stay in the order they were first seen
+    i32 index = i32(tree.nodes.size());
+    if (last_child < 0) {
+        tree.nodes[parent].first_child = index;
+    } else {
+        tree.nodes[last_child].next_sibling = index;
+    }
+    tree.nodes.push_back(node);
+
+    return index;
+}
+
+static void drain_ring(Profile_Ring *ring, Profile_Tree &tree) {
+    u64 pos = ring->read_pos.load(std::memory_order_relaxed);
+    u64 end = ring->write_pos.load(std::memory_order_acquire);
+
+    for (; pos < end; pos++) {
+        const Profile_Event &event = ring->events[pos & (ring->size - 1)];
+
+        if (event.name) {
+            i32 parent = tree.open_zones.empty() ? 0 : tree.open_zones.back().node;
+            i32 node   = find_child(tree, parent, event.name);
+
+            tree.open_zones.push_back({node, event.ticks});
+        } else if (!tree.open_zones.empty()) {
+            Profile_Open_Zone zone    = tree.open_zones.back();
+            u64               elapsed = event.ticks - zone.begin_ticks;
+            Profile_Node     &node    = tree.nodes[zone.node];
+
+            tree.open_zones.pop_back();
+            node.frame_ticks += elapsed;
+            node.frame_count++;
+            histogram_record(*node.histogram, timer_ticks_to_ns(elapsed));
+            tree.nodes[node.parent].frame_child_ticks += elapsed;
+        }
+    }
+
+    ring->read_pos.store(pos, std::memory_order_release);
+}
+
+void profiler_end_frame() {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    u64 now           = timer_ticks();
+    last_frame_ticks  = now - frame_start_ticks;
+    frame_start_ticks = now;
+    frames++;
+
+    for (Profile_Ring *ring = rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        if (trees.size() <= ring->index) {
+            trees.resize(ring->index + 1);
+        }
+
+        Profile_Tree &tree = trees[ring->index];
+        if (tree.nodes.empty()) {
+            Profile_Node root = {};
+            root.parent       = 0;
+            root.first_child  = -1;
+            root.next_sibling = -1;
+            tree.nodes.push_back(root);
+        }
+
+        for (Profile_Node &node : tree.nodes) {
+            node.frame_ticks       = 0;
+            node.frame_child_ticks = 0;
+            node.frame_count       = 0;
+        }
+
+        drain_ring(ring, tree);
+
+        Profile_Node &root = tree.nodes[0];
+        root.frame_ticks   = root.frame_child_ticks;
+        root.frame_count   = 1;
+
+        for (Profile_Node &node : tree.nodes) {
+            node.total_ticks += node.frame_ticks;
+            node.total_child_ticks += node.frame_child_ticks;
+            node.total_count += node.frame_count;
+        }
+    }
+}
+
+void profiler_reset() {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    for (Profile_Tree &tree : trees) {
+        for (Profile_Node &node : tree.nodes) {
+            node.total_ticks       = 0;
+            node.total_child_ticks = 0;
+            node.total_count       = 0;
+
+            if (node.histogram) {
+                histogram_reset(*node.histogram);
+            }
+        }
+    }
+
+    frames = 0;
+}
+
+static f64 ticks_to_ms(u64 ticks) {
+    return f64(timer_ticks_to_ns(ticks)) * 0.000001;
+}
+
+static void report_node(const Profile_Tree &tree, i32 index, i32 depth, const char *name, Histogram_Snapshot &snapshot, std::string &out) {
+    const Profile_Node &node     = tree.nodes[index];
+    f64                 frames_f = f64(frames ? frames : 1);
+
+    if (node.total_count == 0) {
+        return;
+    }
+
+    std::string label = std::string(depth * 2, ' ') + name;
+
+    out += StringF("%-40s %8llu %10.3f %10.3f | %10.2f %10.3f %10.3f", label.c_str(), (unsigned long long)node.frame_count,
+                   ticks_to_ms(node.frame_ticks), ticks_to_ms(node.frame_ticks - node.frame_child_ticks), f64(node.total_count) / frames_f,
+                   ticks_to_ms(node.total_ticks) / frames_f, ticks_to_ms(node.total_ticks - node.total_child_ticks) / frames_f);
+
+    // the root is the thread, not a zone
+    if (node.histogram) {
+        memset(&snapshot, 0, sizeof(snapshot));
+        histogram_merge(snapshot, *node.histogram);
+
+        out += StringF(" | %10.3f %10.3f %10.3f %10.3f", f64(histogram_percentile(snapshot, 50.0)) * 0.000001,
+                       f64(histogram_percentile(snapshot, 99.0)) * 0.000001, f64(histogram_percentile(snapshot, 99.9)) * 0.000001,
+                       f64(snapshot.max) * 0.000001);
+    }
+    out += "\n";
+
+    for (i32 child = node.first_child; child >= 0; child = tree.nodes[child].next_sibling) {
+        report_node(tree, child, depth + 1, tree.nodes[child].name, snapshot, out);
+    }
+}
+
+void profiler_report(const char *file_name) {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    std::string         out;
+    Histogram_Snapshot *snapshot = new Histogram_Snapshot;
+
+    out += StringF("\nprofile: %llu frames, last frame %.3f ms\n", (unsigned long long)frames, ticks_to_ms(last_frame_ticks));
+    out += StringF("%-40s %8s %10s %10s | %10s %10s %10s | %10s %10s %10s %10s\n", "zone", "calls", "incl ms", "excl ms", "avg calls",
+                   "avg incl", "avg excl", "p50 ms", "p99 ms", "p999 ms", "max ms");
+
+    for (Profile_Ring *ring = rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        if (ring->index >= trees.size() || trees[ring->index].nodes.size() < 2) {
+            continue;
+        }
+
+        report_node(trees[ring->index], 0, 0, ring->thread_name, *snapshot, out);
+
+        u64 dropped = ring->dropped.load(std::memory_order_relaxed);
+        if (dropped) {
+            out += StringF("  (%llu zones dropped, ring full)\n", (unsigned long long)dropped);
+        }
+    }
+
+    delete snapshot;
+
+    if (!file_name) {
+        report("%s", out.c_str());
+        return;
+    }
+
+    FILE *file = fopen(file_name, "w");
+    if (!file) {
+        report("profiler_report: can't open %s\n", file_name);
+        return;
+    }
+
+    fwrite(out.data(), 1, out.size(), file);
+    fclose(file);
+}
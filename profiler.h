@@ -0,0 +1,138 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "typedefs.h"
+#include "timer.h"
+
+/*
+===============================================================================
+
+    Hierarchical frame profiler.
+
+        void update() {
+            PROFILE_SCOPE("update");
+            ...
+        }
+
+        profiler_end_frame();       // once per frame, on the main thread
+        profiler_report(NULL);      // through report(), or to a file
+
+    A zone writes a begin and an end event (timer_ticks and the name) into a
+    single producer ring of the calling thread, no locks. profiler_end_frame
+    drains the rings of all threads and folds the events into one call tree
+    per thread with inclusive / exclusive time and call counts for the frame
+    just finished and the totals over all frames. Every zone also gets a
+    histogram.h latency histogram, the report shows its percentiles.
+
+    Zone names must be string literals (or otherwise live forever), zones
+    still open at the end of a frame are counted in the frame they end in.
+
+    PROFILER_ENABLED 0 compiles the zones out.
+
+===============================================================================
+*/
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+struct Profile_Event {
+    u64         ticks;
+    const char *name; // NULL for the end of the innermost zone
+};
+
+struct Profile_Ring {
+    alignas(64) std::atomic<u64> write_pos;
+    u64                          cached_read_pos;
+    u32                          open_depth; // the ring always keeps room for the ends of the open zones
+    u32                          skip_depth; // zones whose begin didn't fit, their ends are dropped too
+
+    alignas(64) std::atomic<u64> read_pos;
+
+    alignas(64) Profile_Event   *events;
+    u64                          size;
+    std::atomic<u64>             dropped;
+    std::atomic<bool>            in_use;
+    u32                          index;
+    char                         thread_name[32];
+    Profile_Ring                *next;
+};
+
+inline thread_local Profile_Ring *profiler_ring = NULL;
+
+Profile_Ring *profiler_acquire_ring();
+
+inline void profiler_write(Profile_Ring *ring, u64 pos, const char *name) {
+    Profile_Event &event = ring->events[pos & (ring->size - 1)];
+
+    event.ticks = timer_ticks();
+    event.name  = name;
+    ring->write_pos.store(pos + 1, std::memory_order_release);
+}
+
+inline void profiler_begin(const char *name) {
+    Profile_Ring *ring = profiler_ring ? profiler_ring : profiler_acquire_ring();
+    u64           pos  = ring->write_pos.load(std::memory_order_relaxed);
+    u64           need = ring->open_depth + 2;
+
+    if (ring->skip_depth == 0 && ring->size - (pos - ring->cached_read_pos) < need) {
+        ring->cached_read_pos = ring->read_pos.load(std::memory_order_acquire);
+    }
+
+    if (ring->skip_depth || ring->size - (pos - ring->cached_read_pos) < need) {
+        ring->skip_depth++;
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring->open_depth++;
+    profiler_write(ring, pos, name);
+}
+
+inline void profiler_end() {
+    Profile_Ring *ring = profiler_ring;
+
+    if (ring->skip_depth) {
+        ring->skip_depth--;
+        return;
+    }
+
+    ring->open_depth--;
+    profiler_write(ring, ring->write_pos.load(std::memory_order_relaxed), NULL);
+}
+
+struct Profile_Scope {
+    Profile_Scope(const char *name) {
+        profiler_begin(name);
+    }
+
+    ~Profile_Scope() {
+        profiler_end();
+    }
+
+    Profile_Scope(const Profile_Scope &)            = delete;
+    Profile_Scope &operator=(const Profile_Scope &) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) Profile_Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+// shows up as the root of the thread's tree, default "thread N"
+void profiler_set_thread_name(const char *name);
+
+// folds every event recorded since the last call into the call trees
+void profiler_end_frame();
+
+// last frame and the per frame averages, through report() if file_name is NULL
+void profiler_report(const char *file_name);
+
+// forgets the totals
+void profiler_reset();
+
+#endif
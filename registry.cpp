@@ -1,177 +1,1196 @@
 #include "registry.h"
 
-#include <Windows.h>
+#include <charconv>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <mutex>
-#include <shared_mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include "tokenizer.h"
 #include "util.h"
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/*
+===============================================================================
+
+     The registry is an immutable snapshot published through an atomic pointer.
+
+     Readers never take a lock: they announce the epoch they are reading in
+     in their own (cache line sized) reader slot, load the current snapshot,
+     copy the value out and clear the slot again.
+
+     Writers are serialized by 'writer_mutex'. They copy the current snapshot,
+     modify the copy, swap it in and free the old one once no reader slot can
+     still reference it (every slot is either idle or in a newer epoch).
+
+     Values are parsed into every type they convert to when they are set, so
+     reads never parse. Every key name gets a slot index that never changes
+     once assigned; a Reg_Handle keeps that index and reads the value straight
+     out of the current snapshot without a name lookup.
+
+     Every writer records which values it changed and calls the subscribers
+     after the new snapshot is published and writer_mutex is released, so a
+     callback may read or write the registry itself.
+
+     reg_compile turns a text file into a binary image next to it
+     ("<file>.bin"): a header, a key table sorted by name with the values
+     already converted to every type, and a string blob. reg_load maps the
+     image and copies the values out without lexing or number parsing, as
+     long as the size and write time of the text file still match the ones
+     recorded in the image. Otherwise it falls back to the text file.
+
+===============================================================================
+*/
+
 namespace {
-std::map<std::string, std::string> kv_pairs;
-std::shared_mutex                  registry_mutex;
+// how the value was written in the file, reg_save writes it back the same way
+enum Reg_Literal : u8 {
+    Reg_Literal_String,
+    Reg_Literal_Number,
+    Reg_Literal_Array,
+};
+
+struct Reg_Value {
+    std::string        text;
+    Reg_Literal        literal   = Reg_Literal_String;
+    bool               present   = false;
+    bool               has_i32   = false;
+    bool               has_f64   = false;
+    bool               has_3f32  = false;
+    i32                i32_value = 0;
+    f32                f32_value = 0.0f;
+    f64                f64_value = 0.0;
+    std::array<f32, 3> f3_value  = {0.0f, 0.0f, 0.0f};
+};
+
+// std::less<> lets lookups take a string_view without building a std::string
+using Key_Index = std::map<std::string, u32, std::less<>>;
+
+struct Reg_Change {
+    std::string name;
+    std::string old_value;
+    std::string new_value;
+    bool        had_old_value;
+    bool        removed = false;
+};
+
+using Change_List = Array_Of<Reg_Change>;
+
+struct Reg_Subscriber {
+    i32                id;
+    std::string        name; // key name or prefix
+    bool               is_prefix;
+    Reg_Change_Fun_Ptr fun;
+    void *             data;
+};
+
+struct Registry_Snapshot {
+    u64                 version;
+    Key_Index           key_index;
+    Array_Of<Reg_Value> values; // indexed by slot
+};
+
+constexpr i32 max_reader_threads = 256;
+
+struct alignas(64) Reader_Slot {
+    std::atomic<u64>  epoch{0}; // 0 = not reading
+    std::atomic<bool> in_use{false};
+};
+
+Reader_Slot                      reader_slots[max_reader_threads];
+std::atomic<u64>                 global_epoch{1};
+std::atomic<Registry_Snapshot *> current_snapshot{new Registry_Snapshot()};
+std::mutex                       writer_mutex;
+
+// the keys each file set on its last load, guarded by writer_mutex
+std::map<std::string, Key_Index> file_keys;
+
+std::mutex               subscriber_mutex;
+Array_Of<Reg_Subscriber> subscribers;
+i32                      next_subscriber_id = 1;
+
+atomic_bool watchers_shutting_down{false};
+
+// a joinable std::thread terminates the process when it's destroyed, so the watchers are joined at exit too
+struct Reg_Watchers {
+    std::mutex           mutex;
+    List_Of<std::thread> threads;
+
+    void stop() {
+        std::lock_guard<std::mutex> watcher_lock(mutex);
+
+        watchers_shutting_down.store(true);
+        for (auto &t : threads) {
+            t.join();
+        }
+        threads.clear();
+    }
+
+    ~Reg_Watchers() {
+        stop();
+    }
+};
+
+Reg_Watchers watchers;
+
+// hands the slot back when the thread exits, so short lived threads don't run out of slots
+struct Reader_Slot_Owner {
+    Reader_Slot *slot = nullptr;
+
+    ~Reader_Slot_Owner() {
+        if (slot) {
+            slot->epoch.store(0, std::memory_order_release);
+            slot->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+Reader_Slot *acquire_reader_slot() {
+    thread_local Reader_Slot_Owner owner;
+
+    if (owner.slot == nullptr) {
+        for (Reader_Slot &slot : reader_slots) {
+            bool expected = false;
+            if (slot.in_use.compare_exchange_strong(expected, true)) {
+                owner.slot = &slot;
+                break;
+            }
+        }
+
+        if (owner.slot == nullptr) {
+            Panic("registry: out of reader slots, raise max_reader_threads");
+        }
+    }
+
+    return owner.slot;
+}
+
+// RAII read side critical section - the snapshot stays alive until it goes out of scope
+struct Read_Guard {
+    Reader_Slot *            slot;
+    const Registry_Snapshot *snapshot;
+
+    Read_Guard() {
+        slot = acquire_reader_slot();
+        slot->epoch.store(global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+        // pairs with the fence in publish_snapshot: either the writer sees this epoch
+        // or this load sees the new snapshot
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        snapshot = current_snapshot.load(std::memory_order_acquire);
+    }
+
+    ~Read_Guard() {
+        slot->epoch.store(0, std::memory_order_release);
+    }
+};
+
+// caller must hold writer_mutex
+void publish_snapshot(Registry_Snapshot *next) {
+    Registry_Snapshot *previous = current_snapshot.load(std::memory_order_relaxed);
+    next->version               = previous->version + 1;
+
+    current_snapshot.store(next, std::memory_order_release);
+    u64 epoch = global_epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    // store-load ordering against Read_Guard, a seq_cst store and acquire load alone don't give it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // wait for the readers that may have picked up 'previous'
+    for (Reader_Slot &slot : reader_slots) {
+        while (true) {
+            u64 reader_epoch = slot.epoch.load(std::memory_order_acquire);
+            if (reader_epoch == 0 || reader_epoch >= epoch) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    delete previous;
+}
+
+const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p < end && *p == '+') {
+        p++;
+    }
+    return p;
+}
+
+// accepts the same prefixes atoi/stof did ("12abc" is 12), but is locale independent
+template <typename Type>
+bool parse_number(const char *begin, const char *end, Type &out) {
+    begin       = skip_spaces(begin, end);
+    auto result = std::from_chars(begin, end, out);
+    return result.ec == std::errc();
+}
+
+Reg_Value parse_value(std::string text) {
+    Reg_Value   value;
+    const char *begin = text.data();
+    const char *end   = begin + text.size();
+
+    value.present   = true;
+    value.has_i32   = parse_number(begin, end, value.i32_value);
+    value.has_f64   = parse_number(begin, end, value.f64_value);
+    value.f32_value = f32(value.f64_value);
+
+    // "x y z" - exactly three space separated numbers, like reg_get_3f32 always expected
+    i32         count = 0;
+    const char *p     = begin;
+    while (p < end) {
+        while (p < end && *p == ' ') {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+
+        const char *token_end = p;
+        while (token_end < end && *token_end != ' ') {
+            token_end++;
+        }
+
+        if (count < 3) {
+            f32 component = 0.0f;
+            parse_number(p, token_end, component);
+            value.f3_value[count] = component;
+        }
+        count++;
+        p = token_end;
+    }
+    value.has_3f32 = (count == 3);
+    if (!value.has_3f32) {
+        value.f3_value = {0.0f, 0.0f, 0.0f};
+    }
+
+    value.text = std::move(text);
+    return value;
+}
+
+u32 intern_key(Registry_Snapshot &snapshot, std::string_view name) {
+    auto entry = snapshot.key_index.find(name);
+    if (entry != snapshot.key_index.end()) {
+        return entry->second;
+    }
+
+    u32 slot = u32(snapshot.values.size());
+    snapshot.key_index.emplace(std::string(name), slot);
+    snapshot.values.emplace_back();
+    return slot;
+}
+
+void store_parsed_value(Registry_Snapshot &snapshot, std::string_view name, Reg_Value value, Change_List &changes) {
+    u32        slot      = intern_key(snapshot, name);
+    Reg_Value &old_value = snapshot.values[slot];
+
+    if (old_value.present && old_value.text == value.text && old_value.literal == value.literal) {
+        return;
+    }
+
+    changes.push_back({std::string(name), old_value.text, value.text, old_value.present});
+    snapshot.values[slot] = std::move(value);
+}
+
+void remove_value(Registry_Snapshot &snapshot, std::string_view name, Change_List &changes) {
+    auto entry = snapshot.key_index.find(name);
+    if (entry == snapshot.key_index.end() || !snapshot.values[entry->second].present) {
+        return;
+    }
+
+    // the slot stays, reg_intern handles keep working and see the default
+    Reg_Value &old_value = snapshot.values[entry->second];
+    changes.push_back({std::string(name), old_value.text, std::string(), true, true});
+    old_value = Reg_Value();
+}
+
+void store_value(Registry_Snapshot &snapshot, std::string_view name, std::string text, Change_List &changes) {
+    store_parsed_value(snapshot, name, parse_value(std::move(text)), changes);
+}
+
+const Reg_Value *find_value(const Registry_Snapshot *snapshot, const char *name) {
+    auto entry = snapshot->key_index.find(std::string_view(name));
+    if (entry == snapshot->key_index.end()) {
+        return nullptr;
+    }
+
+    const Reg_Value *value = &snapshot->values[entry->second];
+    return value->present ? value : nullptr;
+}
+
+const Reg_Value *slot_value(const Registry_Snapshot *snapshot, u32 slot) {
+    if (slot >= snapshot->values.size()) {
+        return nullptr;
+    }
+
+    const Reg_Value *value = &snapshot->values[slot];
+    return value->present ? value : nullptr;
+}
+
+// must not hold writer_mutex
+void notify_subscribers(const Change_List &changes) {
+    if (changes.empty()) {
+        return;
+    }
+
+    Array_Of<Reg_Subscriber> current_subscribers;
+    {
+        std::lock_guard<std::mutex> subscriber_lock(subscriber_mutex);
+        current_subscribers = subscribers;
+    }
+
+    for (const Reg_Change &change : changes) {
+        for (const Reg_Subscriber &sub : current_subscribers) {
+            bool match = sub.is_prefix ? (change.name.compare(0, sub.name.size(), sub.name) == 0) : (change.name == sub.name);
+            if (match) {
+                sub.fun(change.name.c_str(), change.had_old_value ? change.old_value.c_str() : nullptr,
+                        change.removed ? nullptr : change.new_value.c_str(), sub.data);
+            }
+        }
+    }
+}
+
+void set_value(const char *name, std::string text) {
+    Change_List changes;
+    {
+        std::lock_guard<std::mutex> writer_lock(writer_mutex);
+        Registry_Snapshot *         next = new Registry_Snapshot(*current_snapshot.load(std::memory_order_relaxed));
+
+        store_value(*next, name, std::move(text), changes);
+        if (changes.empty()) {
+            delete next; // same value, keep the current snapshot
+        } else {
+            publish_snapshot(next);
+        }
+    }
+    notify_subscribers(changes);
+}
 } // namespace
 
-static void parse_block(nano_lexer &lexer) {
-    std::string current_build;
-    std::string block_type;
+/*
+====================
+text parser
+
+    file    = { "config" STRING block }
+    block   = "{" { IDENT "=" value | IDENT block } "}"
+    value   = STRING | NUMBER | "[" { NUMBER [","] } "]"
 
+nested blocks prefix their keys ("render { shadows { size = 2048 } }" sets
+"render.shadows.size"), blocks named "debug" or "release" don't add a prefix
+and are only applied in that build. Everything is stored straight from the
+token views of the mapped file.
+====================
+*/
+struct Config_Parser {
+    Lexer &            lexer;
+    Registry_Snapshot &snapshot;
+    Change_List &      changes;
+    std::string        key; // prefix of the current block, then the key being parsed
+};
+
+static bool is_build_variant(std::string_view name) {
+    return name == "debug" || name == "release";
+}
+
+static bool build_variant_selected(std::string_view name) {
 #ifdef _DEBUG
-    current_build = "debug";
+    return name == "debug";
 #else
-    current_build = "release";
+    return name == "release";
 #endif
+}
+
+static Reg_Value number_value(const Token_View &token) {
+    Reg_Value value;
 
-    nano_lexer::token token;
-    if (lexer.expect_token(token, nano_lexer::Token_String)) {
-        block_type = token.text;
-        if (lexer.expect_token(token, nano_lexer::Token_Open_Curly_Brace)) {
-            while (lexer.state.ok) {
-                token = lexer.get_token();
-                switch (token.type) {
-                    case nano_lexer::Token_Identifier: {
-                        std::string var_name = token.text;
-                        if (lexer.expect_token(token, nano_lexer::Token_Equal)) {
-                            if (lexer.expect_token(token, nano_lexer::Token_String)) {
-                                std::string var_value = token.text;
-                                // report("cfg_token: %s -> %s\n", var_name.c_str(), var_value.c_str());
-                                kv_pairs[var_name] = var_value;
-                            } else {
-                                lexer.error("parse_block: missing value after '='");
-                            }
-                        } else {
-                            lexer.error("parse_block: missing '='");
-                        }
-                    } break;
-
-                    case nano_lexer::Token_Close_Curly_Brace:
-                        // finished with this block
-                        return;
-
-                    default:
-                        lexer.error("parse_block: unexpected token");
+    value.text      = std::string(token.text);
+    value.literal   = Reg_Literal_Number;
+    value.present   = true;
+    value.has_i32   = true;
+    value.has_f64   = true;
+    value.i32_value = token.int_value;
+    value.f32_value = token.fl_value;
+    value.f64_value = token.dbl_value;
+    return value;
+}
+
+// cursor is behind the '[', the text is the numbers separated by spaces like reg_set used to write them
+static bool parse_array(Lexer &lexer, Reg_Value &value) {
+    i32 count = 0;
+
+    value.literal = Reg_Literal_Array;
+    value.present = true;
+    while (lexer.state.ok) {
+        Token_View token = lexer.PeekTokenView();
+
+        switch (token.type) {
+            case Token_Number:
+                lexer.GetTokenView();
+                if (count == 0) {
+                    value.has_i32   = true;
+                    value.has_f64   = true;
+                    value.i32_value = token.int_value;
+                    value.f32_value = token.fl_value;
+                    value.f64_value = token.dbl_value;
+                } else {
+                    value.text += ' ';
+                }
+                if (count < 3) {
+                    value.f3_value[count] = token.fl_value;
                 }
+                value.text += token.text;
+                count++;
+                break;
+
+            case Token_Comma:
+                lexer.GetTokenView();
+                break;
+
+            case Token_Close_Bracket:
+                lexer.GetTokenView();
+                value.has_3f32 = (count == 3);
+                if (!value.has_3f32) {
+                    value.f3_value = {0.0f, 0.0f, 0.0f};
+                }
+                return true;
+
+            default:
+                lexer.Error("parse_block: number or ']' expected in array");
+                return false;
+        }
+    }
+
+    return false;
+}
+
+// cursor is behind the '='
+static void parse_assignment(Config_Parser &parser, bool apply) {
+    Lexer &    lexer = parser.lexer;
+    Token_View token = lexer.PeekTokenView();
+    Reg_Value  value;
+
+    switch (token.type) {
+        case Token_String:
+            value = parse_value(std::string(token.text));
+            lexer.GetTokenView();
+            break;
+
+        case Token_Number:
+            value = number_value(token);
+            lexer.GetTokenView();
+            break;
+
+        case Token_Open_Bracket:
+            lexer.GetTokenView();
+            if (!parse_array(lexer, value)) {
+                return;
             }
-        } else {
-            lexer.error("opening curly brace is missing");
+            break;
+
+        default:
+            lexer.Error("parse_block: missing value after '='");
+            return;
+    }
+
+    if (apply) {
+        store_parsed_value(parser.snapshot, parser.key, std::move(value), parser.changes);
+    }
+}
+
+// cursor is behind the '{', returns behind the matching '}'
+static void parse_block(Config_Parser &parser, bool apply) {
+    Lexer &lexer = parser.lexer;
+
+    while (lexer.state.ok) {
+        Token_View token = lexer.GetTokenView();
+
+        switch (token.type) {
+            case Token_Identifier: {
+                std::string_view name          = token.text;
+                u64              prefix_length = parser.key.size();
+
+                if (lexer.ExpectToken(token, Token_Equal)) {
+                    parser.key += name;
+                    parse_assignment(parser, apply);
+                } else if (lexer.ExpectToken(token, Token_Open_Curly_Brace)) {
+                    if (is_build_variant(name)) {
+                        parse_block(parser, apply && build_variant_selected(name));
+                    } else {
+                        parser.key += name;
+                        parser.key += '.';
+                        parse_block(parser, apply);
+                    }
+                } else {
+                    lexer.Error("parse_block: missing '=' or '{'");
+                }
+
+                parser.key.resize(prefix_length);
+            } break;
+
+            case Token_Close_Curly_Brace:
+                // finished with this block
+                return;
+
+            case Token_End:
+                lexer.Error("parse_block: missing '}'");
+                return;
+
+            default:
+                lexer.Error("parse_block: unexpected token");
         }
-    } else {
-        lexer.error("config 'platform' expected");
     }
 }
 
-bool reg_load(const char *file_name) {
-    std::unique_lock registry_lock(registry_mutex);
-    nano_lexer       lexer;
+// 'recover' skips broken entries to find the errors behind them, a file with errors always fails
+static bool parse_text_file(const char *file_name, Registry_Snapshot &snapshot, Change_List &changes, bool recover) {
+    Lexer         lexer;
+    Config_Parser parser = {lexer, snapshot, changes, {}};
 
-    lexer.from_file(file_name);
+    lexer.recover       = recover;
+    lexer.report_errors = false;
+    lexer.FromFile(file_name);
     while (lexer.state.ok) {
-        nano_lexer::token token = lexer.get_token();
+        Token_View token = lexer.GetTokenView();
+
+        if (token.type == Token_End) {
+            break;
+        }
 
-        if (token.type == nano_lexer::Token_End) {
-            return true;
+        if (!token.Identifier_Match("config")) {
+            continue;
         }
 
-        if (token.type == nano_lexer::Token_Identifier && token.text == "config") {
-            parse_block(lexer);
+        if (!lexer.ExpectToken(token, Token_String)) {
+            lexer.Error("config 'platform' expected");
+            continue;
         }
+
+        std::string_view name = token.text;
+        if (!lexer.ExpectToken(token, Token_Open_Curly_Brace)) {
+            lexer.Error("opening curly brace is missing");
+            continue;
+        }
+
+        parse_block(parser, !is_build_variant(name) || build_variant_selected(name));
+    }
+
+    if (lexer.error_count == 0) {
+        return lexer.state.ok;
     }
 
+    if (!recover) {
+        // only for the report: every error in the file, what could still be parsed is thrown away
+        Registry_Snapshot scratch = {};
+        Change_List       scratch_changes;
+        return parse_text_file(file_name, scratch, scratch_changes, true);
+    }
+
+    report("%s: %llu errors\n", file_name, (unsigned long long)lexer.error_count);
+    lexer.ReportErrors();
     return false;
 }
 
-void reg_save(const char *file_name) {
-	*(int*)1 = 0; // not implemented
+/*
+====================
+compiled registry image
+====================
+*/
+constexpr u32 reg_image_magic   = 0x31474552; // "REG1"
+constexpr u32 reg_image_version = 3;
+
+// the values are stored with the debug/release blocks already applied
+enum Reg_Image_Variant : u32 {
+    Reg_Image_Release = 1,
+    Reg_Image_Debug   = 2,
+};
+
+#ifdef _DEBUG
+constexpr u32 reg_image_variant = Reg_Image_Debug;
+#else
+constexpr u32 reg_image_variant = Reg_Image_Release;
+#endif
+
+enum Reg_Image_Flags : u32 {
+    Reg_Image_Has_I32  = 1,
+    Reg_Image_Has_F64  = 2,
+    Reg_Image_Has_3F32 = 4,
+    Reg_Image_Number   = 8,
+    Reg_Image_Array    = 16,
+};
+
+struct Reg_Image_Header {
+    u32 magic;
+    u32 version;
+    u64 source_size;
+    i64 source_write_time;
+    u32 key_count;
+    u32 string_bytes;
+    u32 build_variant;
+    u32 reserved;
+};
+
+struct Reg_Image_Entry {
+    u32 name_offset;
+    u32 name_length;
+    u32 text_offset;
+    u32 text_length;
+    u32 flags;
+    i32 i32_value;
+    f64 f64_value;
+    f32 f32_value;
+    f32 f3_value[3];
+};
+
+static_assert(sizeof(Reg_Image_Header) == 40, "the image layout is written to disk as is");
+static_assert(sizeof(Reg_Image_Entry) == 48, "the image layout is written to disk as is");
+
+static std::string image_name(const char *file_name) {
+    return std::string(file_name) + ".bin";
+}
+
+// size + last write time of the text file, 'false' if it doesn't exist
+static bool source_stamp(const char *file_name, u64 &size, i64 &write_time) {
+    std::error_code error;
+
+    size = std::filesystem::file_size(file_name, error);
+    if (error) {
+        return false;
+    }
+
+    write_time = i64(std::filesystem::last_write_time(file_name, error).time_since_epoch().count());
+    return !error;
 }
 
-void reg_set_string(const char *name, const char *value) {
-    std::unique_lock registry_lock(registry_mutex);
+static bool load_image(const char *file_name, Registry_Snapshot &snapshot, Change_List &changes) {
+    Mapped_File image;
+    if (!image.open(image_name(file_name).c_str()) || image.size < sizeof(Reg_Image_Header)) {
+        return false;
+    }
+
+    const Reg_Image_Header *header = (const Reg_Image_Header *)image.data;
+    if (header->magic != reg_image_magic || header->version != reg_image_version) {
+        return false;
+    }
+
+    // written by the other build, its values came from the other variant block
+    if (header->build_variant != reg_image_variant) {
+        return false;
+    }
+
+    u64 entries_bytes = u64(header->key_count) * sizeof(Reg_Image_Entry);
+    if (image.size != sizeof(Reg_Image_Header) + entries_bytes + header->string_bytes) {
+        return false;
+    }
+
+    // a missing text file is fine (shipped the image only), a different one means the image is stale
+    u64 source_size;
+    i64 source_write_time;
+    if (source_stamp(file_name, source_size, source_write_time)) {
+        if (source_size != header->source_size || source_write_time != header->source_write_time) {
+            return false;
+        }
+    }
+
+    const Reg_Image_Entry *entries = (const Reg_Image_Entry *)(image.data + sizeof(Reg_Image_Header));
+    const char *           strings = (const char *)(image.data + sizeof(Reg_Image_Header) + entries_bytes);
+
+    snapshot.values.reserve(snapshot.values.size() + header->key_count);
+    for (u32 i = 0; i < header->key_count; i++) {
+        const Reg_Image_Entry &entry = entries[i];
+
+        if (u64(entry.name_offset) + entry.name_length > header->string_bytes ||
+            u64(entry.text_offset) + entry.text_length > header->string_bytes) {
+            return false;
+        }
+
+        Reg_Value value;
+        value.text        = std::string(strings + entry.text_offset, entry.text_length);
+        value.present     = true;
+        value.has_i32     = (entry.flags & Reg_Image_Has_I32) != 0;
+        value.has_f64     = (entry.flags & Reg_Image_Has_F64) != 0;
+        value.has_3f32    = (entry.flags & Reg_Image_Has_3F32) != 0;
+        value.literal     = (entry.flags & Reg_Image_Number) ? Reg_Literal_Number
+                            : (entry.flags & Reg_Image_Array) ? Reg_Literal_Array
+                                                              : Reg_Literal_String;
+        value.i32_value   = entry.i32_value;
+        value.f32_value   = entry.f32_value;
+        value.f64_value   = entry.f64_value;
+        value.f3_value[0] = entry.f3_value[0];
+        value.f3_value[1] = entry.f3_value[1];
+        value.f3_value[2] = entry.f3_value[2];
 
-    kv_pairs[name] = value;
+        store_parsed_value(snapshot, std::string_view(strings + entry.name_offset, entry.name_length), std::move(value), changes);
+    }
+
+    return true;
 }
 
-void reg_set_i32(const char *name, int value) {
-    std::unique_lock registry_lock(registry_mutex);
+static bool write_image(const char *file_name, const Registry_Snapshot &snapshot) {
+    Reg_Image_Header          header = {};
+    Array_Of<Reg_Image_Entry> entries;
+    std::string               strings;
+
+    header.magic         = reg_image_magic;
+    header.version       = reg_image_version;
+    header.build_variant = reg_image_variant;
+    if (!source_stamp(file_name, header.source_size, header.source_write_time)) {
+        return false;
+    }
+
+    // key_index is sorted by name, so is the table
+    for (const auto &key : snapshot.key_index) {
+        const Reg_Value &value = snapshot.values[key.second];
+        if (!value.present) {
+            continue;
+        }
+
+        Reg_Image_Entry entry = {};
+        entry.name_offset     = u32(strings.size());
+        entry.name_length     = u32(key.first.size());
+        strings += key.first;
+        entry.text_offset = u32(strings.size());
+        entry.text_length = u32(value.text.size());
+        strings += value.text;
+
+        entry.flags = 0;
+        if (value.has_i32) {
+            entry.flags |= Reg_Image_Has_I32;
+        }
+        if (value.has_f64) {
+            entry.flags |= Reg_Image_Has_F64;
+        }
+        if (value.has_3f32) {
+            entry.flags |= Reg_Image_Has_3F32;
+        }
+        if (value.literal == Reg_Literal_Number) {
+            entry.flags |= Reg_Image_Number;
+        } else if (value.literal == Reg_Literal_Array) {
+            entry.flags |= Reg_Image_Array;
+        }
+        entry.i32_value   = value.i32_value;
+        entry.f64_value   = value.f64_value;
+        entry.f32_value   = value.f32_value;
+        entry.f3_value[0] = value.f3_value[0];
+        entry.f3_value[1] = value.f3_value[1];
+        entry.f3_value[2] = value.f3_value[2];
+        entries.push_back(entry);
+    }
+
+    header.key_count    = u32(entries.size());
+    header.string_bytes = u32(strings.size());
+
+    std::string temp_name = image_name(file_name) + ".tmp";
+    {
+        std::ofstream out(temp_name, std::ios::binary | std::ios::trunc);
+
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)entries.data(), std::streamsize(entries.size() * sizeof(Reg_Image_Entry)));
+        out.write(strings.data(), std::streamsize(strings.size()));
+        out.flush();
+
+        if (!out.good()) {
+            report("reg_compile: failed to write %s\n", temp_name.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_name, image_name(file_name), error);
+    if (error) {
+        report("reg_compile: can't replace %s: %s\n", image_name(file_name).c_str(), error.message().c_str());
+        std::filesystem::remove(temp_name, error);
+        return false;
+    }
 
-    kv_pairs[name] = std::to_string(value);
+    return true;
 }
 
-void reg_set_f32(const char *name, float value) {
-    std::unique_lock registry_lock(registry_mutex);
+// keys that are in the file overwrite the current values, keys the file set last time and
+// doesn't have anymore are removed, everything else is left alone
+static bool load_file(const char *file_name, Change_List &changes) {
+    std::lock_guard<std::mutex> writer_lock(writer_mutex);
+    Registry_Snapshot           loaded = {};
+    Change_List                 loaded_changes;
+
+    bool ok = load_image(file_name, loaded, loaded_changes);
+    if (!ok) {
+        // the image was stale or broken, start over from the text
+        loaded = {};
+        ok     = parse_text_file(file_name, loaded, loaded_changes, false);
+    }
+
+    if (!ok) {
+        // a half written or broken file never gets published
+        return false;
+    }
+
+    Registry_Snapshot *next = new Registry_Snapshot(*current_snapshot.load(std::memory_order_relaxed));
+    for (const auto &key : loaded.key_index) {
+        store_parsed_value(*next, key.first, std::move(loaded.values[key.second]), changes);
+    }
+
+    Key_Index &previous_keys = file_keys[file_name];
+    for (const auto &key : previous_keys) {
+        if (loaded.key_index.find(key.first) == loaded.key_index.end()) {
+            remove_value(*next, key.first, changes);
+        }
+    }
+    previous_keys = std::move(loaded.key_index);
+
+    if (changes.empty()) {
+        delete next;
+    } else {
+        publish_snapshot(next);
+    }
 
-    kv_pairs[name] = std::to_string(value);
+    return true;
 }
 
-void reg_set_f64(const char *name, double value) {
-    std::unique_lock registry_lock(registry_mutex);
+bool reg_compile(const char *file_name) {
+    Registry_Snapshot snapshot = {};
+    Change_List       changes;
 
-    kv_pairs[name] = std::to_string(value);
+    if (!parse_text_file(file_name, snapshot, changes, false)) {
+        report("reg_compile: %s has errors, no image written\n", file_name);
+        return false;
+    }
+
+    return write_image(file_name, snapshot);
 }
 
-std::string reg_get_string(const char *name, const char *default_value) {
-    std::shared_lock registry_lock(registry_mutex);
+bool reg_check(const char *file_name) {
+    Registry_Snapshot snapshot = {};
+    Change_List       changes;
 
-    auto value = kv_pairs.find(name);
-    if (value != kv_pairs.end()) {
-        return value->second;
+    if (load_image(file_name, snapshot, changes)) {
+        return true;
     }
-    return default_value;
+
+    snapshot = {};
+    changes.clear();
+    return parse_text_file(file_name, snapshot, changes, false);
 }
 
-int reg_get_i32(const char *name, int default_value) {
-    std::shared_lock registry_lock(registry_mutex);
+bool reg_load(const char *file_name) {
+    Change_List changes;
+    bool        ok = load_file(file_name, changes);
+
+    notify_subscribers(changes);
+    return ok;
+}
 
-    auto value = kv_pairs.find(name);
-    if (value != kv_pairs.end()) {
-        int ret = atoi(value->second.c_str());
-        return ret;
+// the lexer has no escapes, a string value ends at the first '"'
+static bool string_round_trips(const std::string &text) {
+    return text.find_first_of(std::string("\"\r\n\0", 4)) == std::string::npos;
+}
+
+bool reg_save(const char *file_name) {
+    Registry_Snapshot snapshot;
+    {
+        // writers wait for the guard, don't keep them waiting for the disk
+        Read_Guard guard;
+        snapshot = *guard.snapshot;
+    }
+
+    std::string text = "config \"registry\" {\n";
+    for (const auto &entry : snapshot.key_index) {
+        const Reg_Value &value = snapshot.values[entry.second];
+        if (!value.present) {
+            continue;
+        }
+
+        text += "    " + entry.first + " = ";
+        if (value.literal == Reg_Literal_Number) {
+            text += value.text + "\n";
+        } else if (value.literal == Reg_Literal_Array) {
+            std::string elements = value.text;
+            for (u64 i = elements.find(' '); i != std::string::npos; i = elements.find(' ', i + 2)) {
+                elements.replace(i, 1, ", ");
+            }
+            text += "[" + elements + "]\n";
+        } else if (string_round_trips(value.text)) {
+            text += "\"" + value.text + "\"\n";
+        } else {
+            report("reg_save: '%s' has a quote or a line break that can't be written back, %s not saved\n", entry.first.c_str(), file_name);
+            return false;
+        }
+    }
+    text += "}\n";
+
+    std::string temp_name = std::string(file_name) + ".tmp";
+    FILE       *file      = fopen(temp_name.c_str(), "wb");
+    if (!file) {
+        report("reg_save: can't open %s\n", temp_name.c_str());
+        return false;
     }
-    return default_value;
+
+    // on the disk before the rename, a crash leaves the old file or the new one
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size() && platform_sync_file(file);
+    fclose(file);
+
+    std::error_code error;
+    if (!written) {
+        report("reg_save: failed to write %s\n", temp_name.c_str());
+        std::filesystem::remove(temp_name, error);
+        return false;
+    }
+
+    // replaces the old file in one step, readers (and the watcher) never see a half written file
+    std::filesystem::rename(temp_name, file_name, error);
+    if (error) {
+        report("reg_save: can't replace %s: %s\n", file_name, error.message().c_str());
+        std::filesystem::remove(temp_name, error);
+        return false;
+    }
+
+    return true;
 }
 
-float reg_get_f32(const char *name, float default_value) {
-    std::shared_lock registry_lock(registry_mutex);
+i32 reg_subscribe(const char *name, Reg_Change_Fun_Ptr fun, void *data) {
+    std::lock_guard<std::mutex> subscriber_lock(subscriber_mutex);
+
+    i32 id = next_subscriber_id++;
+    subscribers.push_back({id, name, false, fun, data});
+    return id;
+}
+
+i32 reg_subscribe_prefix(const char *prefix, Reg_Change_Fun_Ptr fun, void *data) {
+    std::lock_guard<std::mutex> subscriber_lock(subscriber_mutex);
+
+    i32 id = next_subscriber_id++;
+    subscribers.push_back({id, prefix, true, fun, data});
+    return id;
+}
+
+void reg_unsubscribe(i32 id) {
+    std::lock_guard<std::mutex> subscriber_lock(subscriber_mutex);
 
-    auto value = kv_pairs.find(name);
-    if (value != kv_pairs.end()) {
-        float ret = std::stof(value->second.c_str());
-        return ret;
+    for (auto it = subscribers.begin(); it != subscribers.end(); ++it) {
+        if (it->id == id) {
+            subscribers.erase(it);
+            return;
+        }
     }
-    return default_value;
 }
 
-std::array<float, 3> reg_get_3f32(const char *name) {
-    std::shared_lock registry_lock(registry_mutex);
+static void reload_file(const std::string &file_name) {
+    // editors tend to write in several steps - give them a moment to finish
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    Change_List changes;
+    if (load_file(file_name.c_str(), changes)) {
+        report("registry: reloaded %s, %d value(s) changed\n", file_name.c_str(), i32(changes.size()));
+        notify_subscribers(changes);
+    } else {
+        report("registry: failed to reload %s, keeping the current values\n", file_name.c_str());
+    }
+}
+
+#ifdef __linux__
+static void watcher_thread_entrypoint(std::string file_name) {
+    std::filesystem::path path      = std::filesystem::absolute(file_name);
+    std::string           directory = path.parent_path().string();
+    std::string           base_name = path.filename().string();
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        report("registry: inotify_init1 failed, %s won't be reloaded\n", file_name.c_str());
+        return;
+    }
 
-    std::array<float, 3> ret{0.0f, 0.0f, 0.0f};
-    auto                 value = kv_pairs.find(name);
+    // watch the directory, most editors replace the file instead of writing it in place
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        report("registry: can't watch %s, %s won't be reloaded\n", directory.c_str(), file_name.c_str());
+        close(fd);
+        return;
+    }
 
-    if (value != kv_pairs.end()) {
-        string_array out;
-        split_string(value->second, &out, ' ');
+    alignas(inotify_event) char buffer[4096];
+    while (!watchers_shutting_down.load()) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 250) <= 0) {
+            continue;
+        }
 
-        if (out.size() == 3) {
-            ret[0] = float(atof(out[0].c_str()));
-            ret[1] = float(atof(out[1].c_str()));
-            ret[2] = float(atof(out[2].c_str()));
+        bool    changed = false;
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + length;) {
+                inotify_event *event = (inotify_event *)p;
+                if (event->len && base_name == event->name) {
+                    changed = true;
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
         }
 
-        return ret;
+        if (changed) {
+            reload_file(file_name);
+        }
     }
-    return ret;
+
+    close(fd);
 }
+#else
+static void watcher_thread_entrypoint(std::string file_name) {
+    std::filesystem::path path      = std::filesystem::absolute(file_name);
+    std::string           directory = path.parent_path().string();
+    std::error_code       error;
+    auto                  last_write = std::filesystem::last_write_time(path, error);
 
-double reg_get_f64(const char *name, double default_value) {
-    std::shared_lock registry_lock(registry_mutex);
+    HANDLE change = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (change == INVALID_HANDLE_VALUE) {
+        report("registry: can't watch %s, %s won't be reloaded\n", directory.c_str(), file_name.c_str());
+        return;
+    }
+
+    while (!watchers_shutting_down.load()) {
+        if (WaitForSingleObject(change, 250) != WAIT_OBJECT_0) {
+            continue;
+        }
+
+        // the notification is for the whole directory, only reload if our file was touched
+        auto write_time = std::filesystem::last_write_time(path, error);
+        if (!error && write_time != last_write) {
+            last_write = write_time;
+            reload_file(file_name);
+        }
+
+        FindNextChangeNotification(change);
+    }
+
+    FindCloseChangeNotification(change);
+}
+#endif
+
+void reg_watch(const char *file_name) {
+    std::lock_guard<std::mutex> watcher_lock(watchers.mutex);
+
+    watchers_shutting_down.store(false);
+    watchers.threads.emplace_back(watcher_thread_entrypoint, std::string(file_name));
+}
+
+void reg_stop_watching() {
+    watchers.stop();
+}
+
+void reg_set_string(const char *name, const char *value) {
+    set_value(name, value);
+}
+
+void reg_set_i32(const char *name, int value) {
+    set_value(name, std::to_string(value));
+}
+
+void reg_set_f32(const char *name, float value) {
+    set_value(name, std::to_string(value));
+}
+
+void reg_set_f64(const char *name, double value) {
+    set_value(name, std::to_string(value));
+}
+
+u64 reg_version() {
+    Read_Guard guard;
+
+    return guard.snapshot->version;
+}
+
+u32 reg_intern(const char *name) {
+    {
+        Read_Guard guard;
 
-    auto value = kv_pairs.find(name);
-    if (value != kv_pairs.end()) {
-        double ret = std::stod(value->second.c_str());
-        return ret;
+        auto entry = guard.snapshot->key_index.find(std::string_view(name));
+        if (entry != guard.snapshot->key_index.end()) {
+            return entry->second;
+        }
     }
-    return default_value;
+
+    std::lock_guard<std::mutex> writer_lock(writer_mutex);
+    Registry_Snapshot *         next = new Registry_Snapshot(*current_snapshot.load(std::memory_order_relaxed));
+    u32                         slot = intern_key(*next, name);
+    publish_snapshot(next);
+
+    return slot;
+}
+
+std::string reg_get_string(const char *name, const char *default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = find_value(guard.snapshot, name);
+    return value ? value->text : default_value;
+}
+
+int reg_get_i32(const char *name, int default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = find_value(guard.snapshot, name);
+    return (value && value->has_i32) ? value->i32_value : default_value;
+}
+
+float reg_get_f32(const char *name, float default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = find_value(guard.snapshot, name);
+    return (value && value->has_f64) ? value->f32_value : default_value;
+}
+
+double reg_get_f64(const char *name, double default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = find_value(guard.snapshot, name);
+    return (value && value->has_f64) ? value->f64_value : default_value;
+}
+
+std::array<float, 3> reg_get_3f32(const char *name) {
+    Read_Guard guard;
+
+    const Reg_Value *value = find_value(guard.snapshot, name);
+    return (value && value->has_3f32) ? value->f3_value : std::array<float, 3>{0.0f, 0.0f, 0.0f};
+}
+
+std::string reg_get_slot(u32 slot, const std::string &default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = slot_value(guard.snapshot, slot);
+    return value ? value->text : default_value;
+}
+
+int reg_get_slot(u32 slot, int default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = slot_value(guard.snapshot, slot);
+    return (value && value->has_i32) ? value->i32_value : default_value;
+}
+
+float reg_get_slot(u32 slot, float default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = slot_value(guard.snapshot, slot);
+    return (value && value->has_f64) ? value->f32_value : default_value;
+}
+
+double reg_get_slot(u32 slot, double default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = slot_value(guard.snapshot, slot);
+    return (value && value->has_f64) ? value->f64_value : default_value;
+}
+
+std::array<float, 3> reg_get_slot(u32 slot, const std::array<float, 3> &default_value) {
+    Read_Guard guard;
+
+    const Reg_Value *value = slot_value(guard.snapshot, slot);
+    return (value && value->has_3f32) ? value->f3_value : default_value;
 }
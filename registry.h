@@ -31,17 +31,66 @@ For more information, please refer to <http://unlicense.org>
 #include <string>
 #include <array>
 
+#include "typedefs.h"
+
+// uses "<file_name>.bin" from reg_compile when it's up to date with the text file and built by the same debug/release variant
 bool reg_load(const char *file_name);
-void reg_save(const char *file_name);
+bool reg_compile(const char *file_name);
+// loads the file like reg_load into a scratch copy and throws it away, the live values don't change
+bool reg_check(const char *file_name);
+// writes a temp file next to 'file_name' and renames it over the original
+bool reg_save(const char *file_name);
+
+// reloads 'file_name' on a background thread whenever it changes on disk
+void reg_watch(const char *file_name);
+void reg_stop_watching();
+
+// old_value is NULL when the key didn't exist before, new_value is NULL when a reload removed it
+// (the key was in the file last time and isn't anymore). Called on the thread that changed the value.
+using Reg_Change_Fun_Ptr = void (*)(const char *name, const char *old_value, const char *new_value, void *data);
+
+i32  reg_subscribe(const char *name, Reg_Change_Fun_Ptr fun, void *data);
+i32  reg_subscribe_prefix(const char *prefix, Reg_Change_Fun_Ptr fun, void *data);
+void reg_unsubscribe(i32 id);
 
 void reg_set_string(const char *name, const char *value);
 void reg_set_i32(const char *name, int value);
 void reg_set_f32(const char *name, float value);
 void reg_set_f64(const char *name, double value);
 
+// bumped every time a new registry snapshot is published
+u64 reg_version();
+
 std::string          reg_get_string(const char *name, const char *default_value);
 int                  reg_get_i32(const char *name, int default_value);
 float                reg_get_f32(const char *name, float default_value);
 double               reg_get_f64(const char *name, double default_value);
 std::array<float, 3> reg_get_3f32(const char *name);
+
+// slots are stable for the lifetime of the process, reg_intern only locks the first time a name is seen
+u32                  reg_intern(const char *name);
+std::string          reg_get_slot(u32 slot, const std::string &default_value);
+int                  reg_get_slot(u32 slot, int default_value);
+float                reg_get_slot(u32 slot, float default_value);
+double               reg_get_slot(u32 slot, double default_value);
+std::array<float, 3> reg_get_slot(u32 slot, const std::array<float, 3> &default_value);
+
+//
+// Look the name up once, read it in hot code:
+//
+//     static Reg_Handle<int> cpu_reservation("cpu_reservation", 0);
+//     int n = cpu_reservation.get();
+//
+template <typename Type>
+struct Reg_Handle {
+    u32  slot;
+    Type default_value;
+
+    Reg_Handle(const char *name, const Type &default_value) : slot(reg_intern(name)), default_value(default_value) {
+    }
+
+    Type get() const {
+        return reg_get_slot(slot, default_value);
+    }
+};
 #endif
@@ -29,142 +29,302 @@ For more information, please refer to <http://unlicense.org>
 #define STRINGF_H_
 
 #include <string>
-#include <assert.h>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
 #include <stdint.h>
 
-struct ConcreteArgType
+/*
+===============================================================================
+
+    stringf("player /% has /% hp", name, hp);
+
+    '/%' is replaced by the next argument, '//' is a '/'. The format is parsed
+    at compile time: a placeholder count that doesn't match the arguments is
+    a compile error and at runtime the formatter only copies the literal runs
+    and converts the arguments.
+
+    Output goes into a stack buffer first, numbers are converted with
+    to_chars (floats and doubles fixed with 6 decimals like std::to_string,
+    chars and bools as numbers), so the only allocation is the returned
+    string.
+
+===============================================================================
+*/
+
+// never defined - reaching it while parsing a format turns into a compile error
+void stringfFormatError(const char *error);
+
+template <typename ...Args>
+struct Format_String
 {
-    enum InternalType
+    struct Run
     {
-        FLOAT,
-        DOUBLE,
-        INT32,
-        INT64,
-        CHAR,
-        STR
-    } type;
-
-    union UValue
-    {
-        __int64 int64_value;
-        float fl_value;
-        double dbl_value;
-        int int32_value;
-        char chr_value;       
+        uint32_t offset;
+        uint32_t length;
+        bool     hasEscape;   // contains '//'
     };
 
-    std::string str_value;
-    UValue value;
+    static constexpr size_t argCount = sizeof...(Args);
 
-    ConcreteArgType(float fl) : type(FLOAT)
-    {  
-        value.fl_value = fl;
-    }
+    const char *fmt;
+    Run         runs[argCount + 1];
 
-    ConcreteArgType(double dbl) : type(DOUBLE)
-    {
-        value.dbl_value = dbl;
-    }
-    
-    ConcreteArgType(int i32) : type(INT32)
+    template <size_t N>
+    consteval Format_String(const char (&str)[N]) : fmt(str), runs{}
     {
-        value.int32_value = i32;
-    }
-	
-	ConcreteArgType(char ch) : type(CHAR)
-    {
-        value.chr_value = ch;
-    }
+        size_t runIndex = 0;
+        size_t runStart = 0;
+        bool   escape   = false;
+        size_t i        = 0;
 
-    ConcreteArgType(const char *str) : type(STR)
-    {
-        str_value = str;
+        while (i < N - 1 && str[i])
+        {
+            if (str[i] == '/' && str[i + 1] == '%')
+            {
+                if (runIndex >= argCount)
+                {
+                    stringfFormatError("more '/%' placeholders than arguments");
+                }
+
+                runs[runIndex++] = {uint32_t(runStart), uint32_t(i - runStart), escape};
+                escape           = false;
+                i += 2;
+                runStart = i;
+            }
+            else if (str[i] == '/' && str[i + 1] == '/')
+            {
+                escape = true;
+                i += 2;
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        if (runIndex != argCount)
+        {
+            stringfFormatError("fewer '/%' placeholders than arguments");
+        }
+
+        runs[runIndex] = {uint32_t(runStart), uint32_t(i - runStart), escape};
     }
+};
+
+// keeps counting when the buffer is full so the caller knows how much space it needs
+struct Format_Sink
+{
+    char  *buffer;
+    size_t capacity;
+    size_t length;
 
-    ConcreteArgType(__int64 i64) : type(INT64)
+    void put(const char *str, size_t count)
     {
-        value.int64_value = i64;
+        if (length < capacity)
+        {
+            size_t space = capacity - length;
+            memcpy(buffer + length, str, count < space ? count : space);
+        }
+        length += count;
     }
 
-    ~ConcreteArgType()
+    void put(char ch)
     {
+        if (length < capacity)
+        {
+            buffer[length] = ch;
+        }
+        length++;
     }
 };
 
-template <typename Type, std::size_t N>
-constexpr std::size_t arraySize(const Type (&)[N])
+namespace stringf_detail
 {
-    return N;
-}
+    template <typename Type>
+    inline constexpr bool unsupportedArg = false;
 
-template <typename ...Args>
-std::string stringf(const char *fmt, const Args&... args)
-{
-    std::string     ret             = {};    
-    size_t          size            = strlen(fmt);
-    int             argCounter      = 0;
-    char            *pFmt           = const_cast<char *>(fmt);        
-    ConcreteArgType argArray[]      = {args...};    
-
-    // ret.reserve(512);
-    while (*pFmt)
+    template <typename Type>
+    void putArg(Format_Sink &sink, const Type &value)
     {
-        if (*pFmt == '/' &&  pFmt[1] == '%')
+        if constexpr (std::is_pointer_v<std::decay_t<Type>> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<std::decay_t<Type>>>, char>)
         {
-            if (argCounter >= arraySize(argArray))
-            {
-                assert("check those parameters" && 0);
-                break;
-            }
-            
-            const ConcreteArgType &arg = argArray[argCounter];
-            
-            switch (arg.type)
-            {
-            case ConcreteArgType::FLOAT:
-                ret.append(std::to_string(arg.value.fl_value));                
-                break;
-            case ConcreteArgType::DOUBLE:
-                ret.append(std::to_string(arg.value.dbl_value));
-                break;
-            case ConcreteArgType::INT32:
-                ret.append(std::to_string(arg.value.int32_value));
-                break;
-            case ConcreteArgType::CHAR:
-                ret.append(std::to_string(arg.value.chr_value));
-                break;
-            case ConcreteArgType::STR:
-                ret.append(arg.str_value);
-                break;
-            case ConcreteArgType::INT64:
-                ret.append(std::to_string(arg.value.int64_value));
-                break;
-
-            default:
-                assert("unknown arg type in stringf" && 0);
-                break;
-            }
-
-            pFmt++;
-            argCounter++;
+            const char *str = value;
+            str ? sink.put(str, strlen(str)) : sink.put("(null)", 6);
+        }
+        else if constexpr (std::is_convertible_v<const Type &, std::string_view>)
+        {
+            std::string_view str = value;
+            sink.put(str.data(), str.size());
+        }
+        else if constexpr (std::is_same_v<Type, char>)
+        {
+            putArg(sink, int(value));
+        }
+        else if constexpr (std::is_same_v<Type, bool>)
+        {
+            // to_chars has no bool overload
+            sink.put(value ? '1' : '0');
         }
-        else if (*pFmt == '/' &&  pFmt[1] == '/')
+        else if constexpr (std::is_integral_v<Type>)
         {
-            ret += '/';            
-            pFmt++;
+            char tmp[24];
+            auto result = std::to_chars(tmp, tmp + sizeof(tmp), value);
+            sink.put(tmp, size_t(result.ptr - tmp));
+        }
+        else if constexpr (std::is_floating_point_v<Type>)
+        {
+            // fixed notation of DBL_MAX is 316 characters
+            char tmp[384];
+            auto result = std::to_chars(tmp, tmp + sizeof(tmp), double(value), std::chars_format::fixed, 6);
+            sink.put(tmp, size_t(result.ptr - tmp));
         }
         else
         {
-            ret += *pFmt;
+            static_assert(unsupportedArg<Type>, "unsupported stringf argument type");
+        }
+    }
+
+    template <typename Run>
+    void putRun(Format_Sink &sink, const char *fmt, const Run &run)
+    {
+        const char *pFmt = fmt + run.offset;
+
+        if (!run.hasEscape)
+        {
+            sink.put(pFmt, run.length);
+            return;
+        }
+
+        const char *pEnd = pFmt + run.length;
+        while (pFmt < pEnd)
+        {
+            sink.put(*pFmt);
+            pFmt += (*pFmt == '/' && pFmt + 1 < pEnd && pFmt[1] == '/') ? 2 : 1;
         }
-        
-        pFmt++;
+    }
+}
+
+template <typename ...Args>
+void formatInto(Format_Sink &sink, const Format_String<std::type_identity_t<Args>...> &fmt, const Args&... args)
+{
+    size_t argCounter = 0;
+
+    ((stringf_detail::putRun(sink, fmt.fmt, fmt.runs[argCounter]), stringf_detail::putArg(sink, args), argCounter++), ...);
+    stringf_detail::putRun(sink, fmt.fmt, fmt.runs[argCounter]);
+}
+
+template <typename ...Args>
+std::string stringf(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+{
+    char        stackBuffer[512];
+    Format_Sink sink = {stackBuffer, sizeof(stackBuffer), 0};
+
+    formatInto<Args...>(sink, fmt, args...);
+    if (sink.length <= sizeof(stackBuffer))
+    {
+        return std::string(stackBuffer, sink.length);
     }
 
+    // didn't fit, the first pass measured it
+    std::string ret(sink.length, '\0');
+    sink = {ret.data(), ret.size(), 0};
+    formatInto<Args...>(sink, fmt, args...);
     return ret;
 }
 
+// snprintf style: writes at most capacity - 1 characters plus the terminator,
+// returns the length the whole output needs
+template <typename ...Args>
+size_t format_to(char *buffer, size_t capacity, Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+{
+    Format_Sink sink = {buffer, capacity ? capacity - 1 : 0, 0};
+
+    formatInto<Args...>(sink, fmt, args...);
+    if (capacity)
+    {
+        buffer[sink.length < capacity ? sink.length : capacity - 1] = '\0';
+    }
+    return sink.length;
+}
+
+// appends to 'out', only allocates when the string has to grow
+template <typename ...Args>
+void format_append(std::string &out, Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+{
+    char        stackBuffer[512];
+    Format_Sink sink = {stackBuffer, sizeof(stackBuffer), 0};
+
+    formatInto<Args...>(sink, fmt, args...);
+    if (sink.length <= sizeof(stackBuffer))
+    {
+        out.append(stackBuffer, sink.length);
+        return;
+    }
+
+    size_t oldLength = out.size();
+    out.resize(oldLength + sink.length);
+    sink = {out.data() + oldLength, out.size() - oldLength, 0};
+    formatInto<Args...>(sink, fmt, args...);
+}
+
+/*
+===============================================================================
+
+    Reusable output buffer: keeps its capacity between uses, so formatting
+    into it stops allocating once it has grown to the largest message.
+
+        Format_Buffer &buffer = thread_format_buffer();
+        puts(buffer.format("/% x /%", w, h));
+
+    thread_format_buffer() returns one buffer per thread, the pointer from
+    format() is valid until the next format on the same thread.
+
+===============================================================================
+*/
+
+struct Format_Buffer
+{
+    std::string text;
+
+    void clear()
+    {
+        text.clear();
+    }
+
+    const char *c_str() const
+    {
+        return text.c_str();
+    }
+
+    size_t size() const
+    {
+        return text.size();
+    }
+
+    template <typename ...Args>
+    void append(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        format_append<Args...>(text, fmt, args...);
+    }
+
+    template <typename ...Args>
+    const char *format(Format_String<std::type_identity_t<Args>...> fmt, const Args&... args)
+    {
+        text.clear();
+        format_append<Args...>(text, fmt, args...);
+        return text.c_str();
+    }
+};
+
+inline Format_Buffer &thread_format_buffer()
+{
+    static thread_local Format_Buffer buffer;
+    return buffer;
+}
 
+// no arguments, nothing to parse
 std::string stringf(const char *fmt);
 
 #if STRINGF_IMPLEMENTATION
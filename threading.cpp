@@ -1,20 +1,36 @@
 #include "threading.h"
 #include "registry.h"
 #include "util.h"
-#include <Windows.h>
+#include "platform.h"
+#include "profiler.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "timer.h"
 
 // dont call the destructor on shutdown - none cares
 Async_Worker &worker = *(new Async_Worker());
 
-static void setup_thread(const wchar_t *thread_name, u64 affinity) {
+// ns per task and per wait(), every worker thread records into its own shard
+static const Histogram_Id worker_task_histogram   = histogram_register("worker_task");
+static const Histogram_Id parallel_task_histogram = histogram_register("parallel_task");
+static const Histogram_Id worker_wait_histogram   = histogram_register("worker_wait");
+
+static const Metric_Id worker_tasks_metric    = metric_counter("worker_tasks");
+static const Metric_Id parallel_tasks_metric  = metric_counter("worker_parallel_tasks");
+static const Metric_Id parallel_queued_metric = metric_gauge("worker_parallel_queued");
+
+static void setup_thread(const char *thread_name, u64 affinity) {
     // set priority to low, I don't like stuttering audio and youtube etc. when I'm testing this marvel of software engineering
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+    platform_set_thread_low_priority();
 
-    std::wstring name = thread_name + std::to_wstring(affinity);
-    SetThreadDescription(GetCurrentThread(), name.c_str());
+    std::string name = thread_name + std::to_string(affinity);
+    platform_set_thread_name(name.c_str());
+#if PROFILER_ENABLED
+    profiler_set_thread_name(name.c_str());
+#endif
 }
 
-static void worker_thread_entrypoint(Async_Worker *self, Signal *work_available, u64 affinity, const wchar_t *thread_name) {
+static void worker_thread_entrypoint(Async_Worker *self, Signal *work_available, u64 affinity, const char *thread_name) {
     setup_thread(thread_name, affinity);
 
     while (true) {
@@ -29,7 +45,12 @@ static void worker_thread_entrypoint(Async_Worker *self, Signal *work_available,
 
             // haven't finished with this task group
             if (local_index < self->tasks.size()) {
+                PROFILE_SCOPE("worker_task");
+                u64 start = timer_ticks();
+
                 self->tasks[local_index].task_function(self->tasks[local_index].data);
+                histogram_record(worker_task_histogram, timer_ticks_to_ns(timer_ticks() - start));
+                metric_add(worker_tasks_metric);
             } else {
                 // we have finished - but are we the last one?
                 i32 local_threads_executing = --self->threads_executing;
@@ -48,12 +69,19 @@ static void worker_thread_entrypoint(Async_Worker *self, Signal *work_available,
     }
 }
 
-static void task_processor_entrypoint(Async_Worker *self, u64 affinity, const wchar_t *thread_name) {
+static void task_processor_entrypoint(Async_Worker *self, u64 affinity, const char *thread_name) {
     setup_thread(thread_name, affinity);
 
     while (true) {
         Async_Task at = self->parallel_tasks.pop(); // blocking pop
+        metric_adjust(parallel_queued_metric, -1);
+
+        PROFILE_SCOPE("parallel_task");
+        u64 start = timer_ticks();
+
         at.task_function(at.data);
+        histogram_record(parallel_task_histogram, timer_ticks_to_ns(timer_ticks() - start));
+        metric_add(parallel_tasks_metric);
     }
 
     RT_UNUSED(self)
@@ -94,22 +122,31 @@ void Async_Worker::init() {
 
     for (i32 i = 0; i < num_threads; i++) {
         work_available.emplace_back();
-        worker_threads.emplace_back(worker_thread_entrypoint, this, &work_available.back(), i, L"worker_thread_");
-        task_processors.emplace_back(task_processor_entrypoint, this, i, L"task_processor_");
+        worker_threads.emplace_back(worker_thread_entrypoint, this, &work_available.back(), i, "worker_");
+        task_processors.emplace_back(task_processor_entrypoint, this, i, "task_proc_");
     }
 
     tasks.reserve(1024);
 }
 
+// init() was called and the threads are there to do the work, otherwise wait() never returns
+bool Async_Worker::is_running() const {
+    return num_threads > 0 && !is_shutting_down.load();
+}
+
 void Async_Worker::submit(void *data, Task_Fun_Ptr task_fun) {
     tasks.emplace_back(data, task_fun);
 }
 
 void Async_Worker::parallel_submit(void *data, Task_Fun_Ptr task_fun) {
+    metric_adjust(parallel_queued_metric, 1);
     parallel_tasks.emplace(data, task_fun);
 }
 
 void Async_Worker::wait() {
+    PROFILE_SCOPE("worker_wait");
+    u64 start = timer_ticks();
+
     current_job_index.store(0);
     threads_executing.store(num_threads);
     work_complete.reset();
@@ -120,4 +157,6 @@ void Async_Worker::wait() {
 
     work_complete.wait();
     tasks.clear();
+
+    histogram_record(worker_wait_histogram, timer_ticks_to_ns(timer_ticks() - start));
 }
@@ -4,6 +4,7 @@
 #include "typedefs.h"
 
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -101,9 +102,9 @@ struct Async_Task {
 
 struct Async_Worker {
   private:
-    list_of<std::thread> worker_threads;
-    list_of<std::thread> task_processors;
-    list_of<Signal>      work_available;
+    List_Of<std::thread> worker_threads;
+    List_Of<std::thread> task_processors;
+    List_Of<Signal>      work_available;
     i32                  hw_threads;
     i32                  num_threads;
 
@@ -112,13 +113,14 @@ struct Async_Worker {
     atomic_i32                 current_job_index;
     atomic_i32                 threads_executing;
     Blocking_Queue<Async_Task> parallel_tasks;
-    array_of<Async_Task>       tasks;
+    Array_Of<Async_Task>       tasks;
     Signal                     work_complete;
 
     void init();
     void submit(void *data, Task_Fun_Ptr task_fun);
     void parallel_submit(void *data, Task_Fun_Ptr task_fun);
     void wait();
+    bool is_running() const;
 
     ~Async_Worker();
 };
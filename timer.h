@@ -1,33 +1,172 @@
 #ifndef HIGHRES_TIMER_H_
 #define HIGHRES_TIMER_H_
 
-#include <Windows.h>
+#include "platform.h"
+
+/*
+===============================================================================
+
+    timer_ticks() reads the time stamp counter directly when the CPU has an
+    invariant TSC (constant rate, doesn't stop in sleep states), otherwise it
+    falls back to platform_ticks(). Reading it is a couple of ns instead of a
+    system call / QueryPerformanceCounter.
+
+    Ticks stay integers, the conversion is deferred: timer_ticks_to_ns()
+    multiplies with a 32.32 fixed point ns-per-tick factor that is calibrated
+    against the OS clock (~10 ms) by the first conversion, programs that never
+    convert never pay for it.
+
+        u64 start = timer_ticks();
+        ...
+        u64 ns = timer_ticks_to_ns(timer_ticks() - start);
+
+    timer_ticks_serialized() uses rdtscp, which waits for the preceding
+    instructions to finish, for the end of a measured region.
+
+===============================================================================
+*/
+
+// 0 - always use the OS clock
+#define TIMER_USE_TSC 1
+
+#if TIMER_USE_TSC && (defined(__x86_64__) || defined(_M_X64))
+#define TIMER_TSC_AVAILABLE 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#else
+#define TIMER_TSC_AVAILABLE 0
+#endif
+
+struct Timer_Calibration {
+    uint64_t ns_per_tick; // 32.32 fixed point
+    uint64_t ticks_per_second;
+};
+
+#if TIMER_TSC_AVAILABLE
+// CPUID.80000007H:EDX[8]
+inline bool timer_invariant_tsc() {
+    unsigned int regs[4] = {};
+
+#ifdef _MSC_VER
+    __cpuid((int *)regs, 0x80000000);
+    if (regs[0] < 0x80000007) {
+        return false;
+    }
+    __cpuid((int *)regs, 0x80000007);
+#else
+    if (!__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3]) || regs[0] < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+
+    return (regs[3] >> 8) & 1;
+}
+
+// a function local static, ticks taken during another file's static init already use the TSC
+inline bool timer_uses_tsc() {
+    static const bool uses_tsc = timer_invariant_tsc();
+    return uses_tsc;
+}
+#else
+inline bool timer_uses_tsc() {
+    return false;
+}
+#endif
+
+inline uint64_t timer_ticks() {
+#if TIMER_TSC_AVAILABLE
+    if (timer_uses_tsc()) {
+        return __rdtsc();
+    }
+#endif
+    return uint64_t(platform_ticks());
+}
+
+inline uint64_t timer_ticks_serialized() {
+#if TIMER_TSC_AVAILABLE
+    if (timer_uses_tsc()) {
+        unsigned int aux;
+        return __rdtscp(&aux);
+    }
+#endif
+    return uint64_t(platform_ticks());
+}
+
+// the 64x64 -> 128 bit product shifted right by 32
+inline uint64_t timer_mul_shift_32(uint64_t a, uint64_t b) {
+#ifdef _MSC_VER
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return (high << 32) | (low >> 32);
+#else
+    return uint64_t(((unsigned __int128)a * b) >> 32);
+#endif
+}
+
+inline Timer_Calibration timer_calibrate() {
+    Timer_Calibration calibration;
+
+    if (!timer_uses_tsc()) {
+        calibration.ticks_per_second = uint64_t(platform_ticks_per_second());
+    } else {
+        // count TSC ticks over ~10 ms of the OS clock
+        int64_t  os_frequency = platform_ticks_per_second();
+        int64_t  os_start     = platform_ticks();
+        uint64_t tsc_start    = timer_ticks();
+        int64_t  os_end       = os_start;
+
+        while (os_end - os_start < os_frequency / 100) {
+            os_end = platform_ticks();
+        }
+        uint64_t tsc_end = timer_ticks();
+
+        calibration.ticks_per_second = uint64_t(double(tsc_end - tsc_start) * double(os_frequency) / double(os_end - os_start));
+    }
+
+    calibration.ns_per_tick = uint64_t((1000000000.0 * 4294967296.0) / double(calibration.ticks_per_second));
+    return calibration;
+}
+
+// calibrated on first use, also from the static init of any file
+inline const Timer_Calibration &timer_calibration() {
+    static const Timer_Calibration calibration = timer_calibrate();
+    return calibration;
+}
+
+inline uint64_t timer_ticks_to_ns(uint64_t ticks) {
+    return timer_mul_shift_32(ticks, timer_calibration().ns_per_tick);
+}
 
 struct High_Res_Timer {
-    LARGE_INTEGER StartingTime;
-    double        Frequency;
+    uint64_t StartingTime;
 
     High_Res_Timer() {
-        LARGE_INTEGER freq;
-        QueryPerformanceFrequency(&freq);
-        Frequency = double(freq.QuadPart);
-        QueryPerformanceCounter(&StartingTime);
+        StartingTime = timer_ticks();
     }
 
     void reset() {
-        QueryPerformanceCounter(&StartingTime);
+        StartingTime = timer_ticks();
+    }
+
+    uint64_t get_ticks() {
+        return timer_ticks() - StartingTime;
+    }
+
+    uint64_t get_time_ns() {
+        return timer_ticks_to_ns(timer_ticks() - StartingTime);
     }
 
     double get_time_ms() {
-        LARGE_INTEGER EndingTime;
-        QueryPerformanceCounter(&EndingTime);
-        return ((double(EndingTime.QuadPart - StartingTime.QuadPart) * 1000.0) / Frequency);
+        return double(get_time_ns()) * 0.000001;
     }
 
     double get_time_micro() {
-        LARGE_INTEGER EndingTime;
-        QueryPerformanceCounter(&EndingTime);
-        return ((double(EndingTime.QuadPart - StartingTime.QuadPart) * 1000000.0) / Frequency);
+        return double(get_time_ns()) * 0.001;
     }
 
 	static High_Res_Timer* it() {
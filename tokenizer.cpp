@@ -1,62 +1,497 @@
 #include "tokenizer.h"
+#include "threading.h"
+#include "metrics.h"
 #include "util.h"
 
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+
+// 0 = plain C++ scanning loops, 1 = SSE scanning loops (16 bytes per step)
+#ifndef LEXER_SIMD
+#define LEXER_SIMD 1
+#endif
+
+/*
+===============================================================================
+
+     Character classification and the hot scanning loops.
+
+     Every loop returns the position of the first character that ends the run
+     (or 'end'). The SIMD versions classify 16 bytes at a time with compares
+     and a movemask, only load full 16 byte blocks that are inside the input
+     and finish the tail with the scalar version, so both produce exactly the
+     same positions.
+
+===============================================================================
+*/
+
+namespace {
+enum Char_Class : u8 {
+    Char_Alpha      = 1,
+    Char_Digit      = 2,
+    Char_Identifier = 4, // alpha, digit, '.', '_'
+    Char_Space      = 8,
+    Char_Hex_Digit  = 16,
+};
+
+struct Char_Class_Table {
+    u8 classes[256];
+
+    constexpr Char_Class_Table() : classes{} {
+        for (i32 c = 'a'; c <= 'z'; c++) {
+            classes[c] = Char_Alpha | Char_Identifier;
+        }
+        for (i32 c = 'A'; c <= 'Z'; c++) {
+            classes[c] = Char_Alpha | Char_Identifier;
+        }
+        for (i32 c = '0'; c <= '9'; c++) {
+            classes[c] = Char_Digit | Char_Identifier | Char_Hex_Digit;
+        }
+        for (i32 c = 0; c < 6; c++) {
+            classes['a' + c] |= Char_Hex_Digit;
+            classes['A' + c] |= Char_Hex_Digit;
+        }
+        classes[u8('.')]  = Char_Identifier;
+        classes[u8('_')]  = Char_Identifier;
+        classes[u8(' ')]  = Char_Space;
+        classes[u8('\t')] = Char_Space;
+        classes[u8('\r')] = Char_Space;
+        classes[u8('\n')] = Char_Space;
+    }
+};
+
+constexpr Char_Class_Table char_class_table;
+
+inline bool HasClass(i8 c, u8 char_class) {
+    return (char_class_table.classes[u8(c)] & char_class) != 0;
+}
+
+u64 SkipClassScalar(const i8 *data, u64 pos, u64 end, u8 char_class) {
+    while (pos < end && HasClass(data[pos], char_class)) {
+        pos++;
+    }
+    return pos;
+}
+
+u64 SkipSpacesScalar(const i8 *data, u64 pos, u64 end, i32 &newlines) {
+    while (pos < end && HasClass(data[pos], Char_Space)) {
+        newlines += (data[pos] == '\n');
+        pos++;
+    }
+    return pos;
+}
+
+u64 FindEitherScalar(const i8 *data, u64 pos, u64 end, i8 a, i8 b) {
+    while (pos < end && data[pos] != a && data[pos] != b) {
+        pos++;
+    }
+    return pos;
+}
+
+u64 CountQuotesScalar(const i8 *data, u64 pos, u64 end) {
+    u64 count = 0;
+    for (; pos < end; pos++) {
+        count += (data[pos] == '"');
+    }
+    return count;
+}
+
+// position right behind the first newline that isn't inside a string, 'end' if there is none
+u64 FindLineStartOutsideQuotesScalar(const i8 *data, u64 pos, u64 end, bool in_string) {
+    for (; pos < end; pos++) {
+        if (data[pos] == '"') {
+            in_string = !in_string;
+        } else if (data[pos] == '\n' && !in_string) {
+            return pos + 1;
+        }
+    }
+    return end;
+}
+
+u64 SkipHexDigits(const i8 *data, u64 pos, u64 end) {
+    return SkipClassScalar(data, pos, end, Char_Hex_Digit);
+}
+
+u32 HexDigitValue(i8 c) {
+    return (c <= '9') ? u32(c - '0') : u32((c | 0x20) - 'a' + 10);
+}
+
+i32 ClampToI32(f64 value) {
+    if (value >= 2147483647.0) {
+        return 2147483647;
+    }
+    if (value <= -2147483648.0) {
+        return i32(-2147483647 - 1);
+    }
+    return i32(value);
+}
+
+//
+// Fills the numeric fields of a number token. Integers up to 64 bits are converted exactly
+// without going through floating point. Everything else goes to from_chars, which is
+// locale independent and exactly rounded (Eisel-Lemire in the current standard libraries).
+//
+void ConvertNumber(std::string_view text, bool is_float, bool is_hex, Token_View &token) {
+    bool             negative = !text.empty() && text[0] == '-';
+    std::string_view body     = negative ? text.substr(1) : text;
+    std::string_view digits   = is_hex ? body.substr(2) : body;
+
+    if (!is_float) {
+        u64  value    = 0;
+        bool overflow = false;
+
+        for (i8 c : digits) {
+            u32 digit = is_hex ? HexDigitValue(c) : u32(c - '0');
+            u64 base  = is_hex ? 16 : 10;
+
+            if (value > (~u64(0) - digit) / base) {
+                overflow = true;
+                break;
+            }
+            value = value * base + digit;
+        }
+
+        if (!overflow) {
+            token.dbl_value = negative ? -f64(value) : f64(value);
+            token.fl_value  = f32(token.dbl_value);
+            token.int_value = ClampToI32(token.dbl_value);
+            return;
+        }
+
+        // doesn't fit into 64 bits, let the float path round it
+        if (is_hex) {
+            f64 fvalue = 0.0;
+            for (i8 c : digits) {
+                fvalue = fvalue * 16.0 + f64(HexDigitValue(c));
+            }
+            token.dbl_value = negative ? -fvalue : fvalue;
+            token.fl_value  = f32(token.dbl_value);
+            token.int_value = ClampToI32(token.dbl_value);
+            return;
+        }
+    }
+
+    std::chars_format format = is_hex ? std::chars_format::hex : std::chars_format::general;
+    f64               dvalue = 0.0;
+    f32               fvalue = 0.0f;
+
+    std::from_chars(digits.data(), digits.data() + digits.size(), dvalue, format);
+    std::from_chars(digits.data(), digits.data() + digits.size(), fvalue, format);
+
+    token.dbl_value = negative ? -dvalue : dvalue;
+    token.fl_value  = negative ? -fvalue : fvalue;
+    token.int_value = ClampToI32(std::trunc(token.dbl_value));
+}
+
+#if LEXER_SIMD
+inline u32 LowestSetBit(u32 mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return u32(index);
+#else
+    return u32(__builtin_ctz(mask));
+#endif
+}
+
+inline __m128i LoadBlock(const i8 *data, u64 pos) {
+    return _mm_loadu_si128((const __m128i *)(data + pos));
+}
+
+// 0xff for every byte where (c - low) <= (high - low), unsigned
+inline __m128i InRange(__m128i block, i8 low, i8 high) {
+    __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(i8(high - low))), offset);
+}
+
+// bit n set = byte n is an identifier character
+inline u32 IdentifierMask(__m128i block) {
+    __m128i alpha = InRange(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = InRange(block, '0', '9');
+    __m128i dot   = _mm_cmpeq_epi8(block, _mm_set1_epi8('.'));
+    __m128i under = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+
+    return u32(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), _mm_or_si128(dot, under))));
+}
+
+u64 SkipIdentifier(const i8 *data, u64 pos, u64 end) {
+    for (; pos + 16 <= end; pos += 16) {
+        u32 stop = ~IdentifierMask(LoadBlock(data, pos)) & 0xffff;
+        if (stop) {
+            return pos + LowestSetBit(stop);
+        }
+    }
+    return SkipClassScalar(data, pos, end, Char_Identifier);
+}
+
+u64 SkipDigits(const i8 *data, u64 pos, u64 end) {
+    for (; pos + 16 <= end; pos += 16) {
+        u32 stop = ~u32(_mm_movemask_epi8(InRange(LoadBlock(data, pos), '0', '9'))) & 0xffff;
+        if (stop) {
+            return pos + LowestSetBit(stop);
+        }
+    }
+    return SkipClassScalar(data, pos, end, Char_Digit);
+}
+
+u64 SkipSpaces(const i8 *data, u64 pos, u64 end, i32 &newlines) {
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i block   = LoadBlock(data, pos);
+        __m128i newline = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+        __m128i space   = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+                                       _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')), newline));
+        u32     newline_mask = u32(_mm_movemask_epi8(newline));
+        u32     stop         = ~u32(_mm_movemask_epi8(space)) & 0xffff;
+
+        if (stop) {
+            u32 index = LowestSetBit(stop);
+            newlines += std::popcount(newline_mask & ((1u << index) - 1));
+            return pos + index;
+        }
+        newlines += std::popcount(newline_mask);
+    }
+    return SkipSpacesScalar(data, pos, end, newlines);
+}
+
+u64 FindEither(const i8 *data, u64 pos, u64 end, i8 a, i8 b) {
+    const __m128i match_a = _mm_set1_epi8(a);
+    const __m128i match_b = _mm_set1_epi8(b);
+
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i block = LoadBlock(data, pos);
+        u32     found = u32(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, match_a), _mm_cmpeq_epi8(block, match_b))));
+        if (found) {
+            return pos + LowestSetBit(found);
+        }
+    }
+    return FindEitherScalar(data, pos, end, a, b);
+}
+
+// prefix xor of a 16 bit mask - bit n = parity of the bits 0..n
+inline u32 PrefixXor(u32 mask) {
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    return mask & 0xffff;
+}
+
+u64 CountQuotes(const i8 *data, u64 pos, u64 end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    u64           count = 0;
+
+    for (; pos + 16 <= end; pos += 16) {
+        count += std::popcount(u32(_mm_movemask_epi8(_mm_cmpeq_epi8(LoadBlock(data, pos), quote))));
+    }
+    return count + CountQuotesScalar(data, pos, end);
+}
+
+u64 FindLineStartOutsideQuotes(const i8 *data, u64 pos, u64 end, bool in_string) {
+    const __m128i quote   = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i block         = LoadBlock(data, pos);
+        u32     quote_mask    = u32(_mm_movemask_epi8(_mm_cmpeq_epi8(block, quote)));
+        u32     newline_mask  = u32(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        u32     inside_string = PrefixXor(quote_mask) ^ (in_string ? 0xffff : 0);
+        u32     candidates    = newline_mask & ~inside_string;
+
+        if (candidates) {
+            return pos + LowestSetBit(candidates) + 1;
+        }
+        in_string ^= (std::popcount(quote_mask) & 1) != 0;
+    }
+    return FindLineStartOutsideQuotesScalar(data, pos, end, in_string);
+}
+#else
+u64 CountQuotes(const i8 *data, u64 pos, u64 end) {
+    return CountQuotesScalar(data, pos, end);
+}
+
+u64 FindLineStartOutsideQuotes(const i8 *data, u64 pos, u64 end, bool in_string) {
+    return FindLineStartOutsideQuotesScalar(data, pos, end, in_string);
+}
+
+u64 SkipIdentifier(const i8 *data, u64 pos, u64 end) {
+    return SkipClassScalar(data, pos, end, Char_Identifier);
+}
+
+u64 SkipDigits(const i8 *data, u64 pos, u64 end) {
+    return SkipClassScalar(data, pos, end, Char_Digit);
+}
+
+u64 SkipSpaces(const i8 *data, u64 pos, u64 end, i32 &newlines) {
+    return SkipSpacesScalar(data, pos, end, newlines);
+}
+
+u64 FindEither(const i8 *data, u64 pos, u64 end, i8 a, i8 b) {
+    return FindEitherScalar(data, pos, end, a, b);
+}
+#endif
+} // namespace
+
 bool Lexer::IsAlpha(i8 c) {
-    bool b = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'));
-    return b;
+    return HasClass(c, Char_Alpha);
 }
 
 bool Lexer::IsNumber(i8 c) {
-    bool b = ((c >= '0') && (c <= '9'));
-    return b;
+    return HasClass(c, Char_Digit);
 }
 
 void Lexer::Refill() {
-    u64 remaining_characters = input.length() - state.cursor;
-    if (remaining_characters == 0 || state.cursor >= input.length()) {
-        state.script_pointer = 0;
-    } else if (remaining_characters >= 1) {
-        state.script_pointer = input[state.cursor];
+    if (state.cursor >= length) {
+        FillWindow();
+    }
+
+    state.script_pointer = (state.cursor < length) ? data[state.cursor] : 0;
+}
+
+// streaming only: drops everything before the current token and reads the next chunk behind it
+bool Lexer::FillWindow() {
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    u64 keep = state.token_start;
+    input.erase(0, keep);
+    window_offset += keep;
+    state.cursor -= keep;
+    state.token_start = 0;
+
+    u64 old_size = input.size();
+    input.resize(old_size + chunk_size);
+    stream.read(&input[old_size], std::streamsize(chunk_size));
+    u64 bytes_read = u64(stream.gcount());
+    input.resize(old_size + bytes_read);
+
+    if (bytes_read == 0) {
+        stream.close();
+    }
+
+    data   = input.data();
+    length = input.size();
+    return bytes_read > 0;
+}
+
+// runs 'skip' from the cursor, reading more input whenever the run reaches the end of the window
+template <typename Skip_Fun>
+void Lexer::ScanRun(Skip_Fun skip) {
+    while (true) {
+        u64 pos = skip(data, state.cursor, length);
+        if (pos < length) {
+            Seek(pos);
+            return;
+        }
+
+        // FillWindow moves the cursor along when it drops the bytes in front of the token
+        state.cursor = pos;
+        if (!FillWindow()) {
+            Seek(state.cursor);
+            return;
+        }
+    }
+}
+
+// looks 'ahead' characters past the cursor without moving it, 0 past the end of the input
+i8 Lexer::PeekChar(u64 ahead) {
+    while (state.cursor + ahead >= length) {
+        if (!FillWindow()) {
+            return 0;
+        }
     }
+    return data[state.cursor + ahead];
 }
 
-string Lexer::Forward(int count) {
-    string s;
-    for (int i = 0; i < count; i++) {
-        if (state.cursor + i < input.length()) {
-            s += input[state.cursor + i];
+// [-] digits [. digits] [e|E [+|-] digits]    or    [-] 0x hex_digits [. hex_digits] [p|P [+|-] digits]
+void Lexer::ScanNumber(Token_View &token) {
+    bool is_float = false;
+    bool is_hex   = false;
+    i8   first    = data[state.token_start];
+
+    if (first == '-') {
+        first = state.script_pointer;
+        if (IsNumber(first)) {
+            Advance(1);
         }
     }
+
+    if (first == '0' && (state.script_pointer == 'x' || state.script_pointer == 'X') && HasClass(PeekChar(1), Char_Hex_Digit)) {
+        is_hex = true;
+        Advance(1);
+        ScanRun(SkipHexDigits);
+    } else {
+        ScanRun(SkipDigits);
+    }
+
+    if (state.script_pointer == '.') {
+        is_float = true;
+        Advance(1);
+        ScanRun(is_hex ? SkipHexDigits : SkipDigits);
+    }
+
+    i8 exponent = is_hex ? 'p' : 'e';
+    if ((state.script_pointer | 0x20) == exponent) {
+        i8 next = PeekChar(1);
+        if (IsNumber(next) || ((next == '+' || next == '-') && IsNumber(PeekChar(2)))) {
+            is_float = true;
+            Advance((next == '+' || next == '-') ? 2 : 1);
+            ScanRun(SkipDigits);
+        }
+    }
+
+    token.text = std::string_view(data + state.token_start, state.cursor - state.token_start);
+    ConvertNumber(token.text, is_float, is_hex, token);
+}
+
+void Lexer::Advance(u64 count) {
     state.cursor += count;
     Refill();
-    return s;
 }
 
-string Lexer::ConsumeLine() {
-    string s;
-    while (state.script_pointer && state.script_pointer != '\n') {
-        s += Forward(1);
+void Lexer::Seek(u64 cursor) {
+    state.cursor = cursor;
+    Refill();
+}
+
+std::string_view Lexer::ConsumeLine() {
+    state.token_start = state.cursor;
+    ScanRun([](const i8 *d, u64 pos, u64 end) { return FindEither(d, pos, end, '\n', '\0'); });
+    return std::string_view(data + state.token_start, state.cursor - state.token_start);
+}
+
+// every character is scanned once - a peeked token is kept until Get* hands it out
+const Token_View &Lexer::PeekTokenView() {
+    if (!has_lookahead) {
+        lookahead     = ScanToken();
+        has_lookahead = true;
     }
-    return s;
+
+    return lookahead;
 }
 
 Token Lexer::PeekToken() {
-    Tokenizer_State temp  = state;
-    Token           token = GetToken();
-    state                 = temp; // reset the tokenizer to the state before 'get_token'
-
-    return token;
+    return PeekTokenView().ToToken();
 }
 
 bool Lexer::ExpectToken(Token &t, Token_Type expected) {
-    Token tmp    = PeekToken();
-    bool  result = (tmp.type == expected);
+    bool result = (PeekTokenView().type == expected);
     if (result) {
         t = GetToken();
     }
     return result;
 }
 
+bool Lexer::ExpectToken(Token_View &t, Token_Type expected) {
+    bool result = (PeekTokenView().type == expected);
+    if (result) {
+        t = GetTokenView();
+    }
+    return result;
+}
+
 bool Lexer::ExpectIdentifier(Token &t, const string &text) {
     bool result = false;
     if (ExpectToken(t, Token_Identifier)) {
@@ -69,129 +504,306 @@ bool Lexer::ExpectIdentifier(Token &t, const string &text) {
 }
 
 Token Lexer::GetToken() {
+    return GetTokenView().ToToken();
+}
+
+Token_View Lexer::GetTokenView() {
+    if (has_lookahead) {
+        next_token    = lookahead;
+        has_lookahead = false;
+    } else {
+        next_token = ScanToken();
+    }
+
+    if (next_token.type == Token_End) {
+        state.eof = true;
+    }
+
+    return next_token;
+}
+
+Token_View Lexer::ScanToken() {
+    Token_View token;
+
     while (1) {
-        next_token = {};
+        token = {};
 
         if (state.ok == false) {
-            next_token.type = Token_Unknown;
-            return next_token;
+            token.type = Token_Unknown;
+            return token;
         }
 
-        i8 current_char = state.script_pointer;
-        next_token.text += current_char;
-        Forward(1);
-        switch (current_char) {
-            case '\0':
-                next_token.type = Token_End;
-                state.eof       = true;
-                return next_token;
+        state.token_start = state.cursor;
+        i8 current_char   = state.script_pointer;
+        token.line        = state.line;
+        Advance(1);
+        token.text = std::string_view(data + state.token_start, 1);
+        switch (config->actions[u8(current_char)]) {
+            case Lexer_Config::Action_End:
+                token.type = Token_End;
+                token.text = {};
+                return token;
 
-            case '/':
-                next_token.type = Token_Forward_Slash;
-                return next_token;
+            case Lexer_Config::Action_Punctuation:
+                token.type = Token_Type(config->punctuation[u8(current_char)]);
+                return token;
 
-            case '#':          // TODO: comment tokens are hard coded
+            case Lexer_Config::Action_Line_Comment:
                 ConsumeLine(); // ignore comments
                 continue;
 
-            case '{':
-                next_token.type = Token_Open_Curly_Brace;
-                return next_token;
-
-            case '}':
-                next_token.type = Token_Close_Curly_Brace;
-                return next_token;
-
-            case '=':
-                next_token.type = Token_Equal;
-                return next_token;
-
-            case '"':
-                next_token.type = Token_String;
-                while (state.script_pointer && state.script_pointer != '"') {
-                    next_token.text += Forward(1);
-                }
-                if (state.script_pointer && state.script_pointer == '"') {
-                    next_token.text += Forward(1);
-                }
-                if (next_token.text[0] == '"') {
-                    next_token.text.erase(0, 1);
-                }
-                if (next_token.text[next_token.text.length() - 1] == '"') {
-                    next_token.text.pop_back();
+            case Lexer_Config::Action_String:
+                token.type = Token_String;
+                ScanRun([](const i8 *d, u64 pos, u64 end) { return FindEither(d, pos, end, '"', '\0'); });
+                if (state.script_pointer == '"') {
+                    Advance(1);
+                    token.text = std::string_view(data + state.token_start + 1, state.cursor - state.token_start - 2);
                 } else {
-                    report("****** Incomplete string ******\n");
-                    state.ok = false;
+                    if (AddError(Lexer_Error_Incomplete_String, state.token_start, token.line, '"', nullptr)) {
+                        continue;
+                    }
+                    token.text = std::string_view(data + state.token_start + 1, state.cursor - state.token_start - 1);
                 }
-                return next_token;
+                return token;
 
-            case ' ':
-            case '\t':
-            case '\r':
-            case '\n':
+            case Lexer_Config::Action_Space:
                 if (current_char == '\n') {
                     state.line++;
                 }
-                next_token.type = Token_Spacing;
+                {
+                    i32 newlines = 0;
+                    ScanRun([&newlines](const i8 *d, u64 pos, u64 end) { return SkipSpaces(d, pos, end, newlines); });
+                    state.line += newlines;
+                }
+                token.type = Token_Spacing;
                 continue;
 
-            default:
-                if (IsAlpha(current_char)) {
-                    next_token.type = Token_Identifier;
-                    while (IsAlpha(state.script_pointer) || IsNumber(state.script_pointer) || state.script_pointer == '.' ||
-                           state.script_pointer == '_') {
-                        next_token.text += Forward(1);
-                    }
-                } else if (IsNumber(current_char) || current_char == '-') {
-                    next_token.type = Token_Number;
-                    while (IsNumber(state.script_pointer)) {
-                        next_token.text += Forward(1);
-                    }
+            case Lexer_Config::Action_Number:
+                token.type = Token_Number;
+                ScanNumber(token);
+                return token;
 
-                    if (state.script_pointer == '.') {
-                        next_token.text += '.';
-                        Forward(1);
+            case Lexer_Config::Action_Identifier:
+                token.type = Token_Identifier;
+                ScanRun(SkipIdentifier);
+                token.text    = std::string_view(data + state.token_start, state.cursor - state.token_start);
+                token.keyword = config->keywords.Find(token.text);
+                if (token.keyword >= 0) {
+                    token.type = Token_Keyword;
+                }
+                return token;
 
-                        while (IsNumber(state.script_pointer)) {
-                            next_token.text += Forward(1);
-                        }
-                        // TODO: atof
-                    } else {
-                        // TODO: atoi
+            case Lexer_Config::Action_Slash:
+                if (state.script_pointer == '/' && (config->comments & Comment_Double_Slash)) {
+                    ConsumeLine();
+                    continue;
+                }
+                if (state.script_pointer == '*' && (config->comments & Comment_Block)) {
+                    Advance(1);
+                    if (ScanBlockComment()) {
+                        continue;
                     }
+                    token.type = Token_Unknown;
+                    token.text = std::string_view(data + state.token_start, 2);
+                    return token;
+                }
+                if (config->punctuation[u8('/')] != Token_Unknown) {
+                    token.type = Token_Forward_Slash;
+                    return token;
+                }
+                [[fallthrough]];
 
-                } else {
-                    next_token.type = Token_Unknown;
-                    state.ok        = false;
-                    report("\n\n****** Unexpected error ******\n\nUnknown token '%s' at line %d\n", next_token.text.c_str(), state.line);
+            default:
+                if (AddError(Lexer_Error_Unknown_Token, state.token_start, token.line, current_char, nullptr)) {
+                    Resync();
+                    continue;
                 }
-                return next_token;
+                token.type = Token_Unknown;
+                return token;
+        }
+    }
+}
+
+// cursor is right behind the opening "/*", stops behind the closing "*/" - false if lexing stopped
+bool Lexer::ScanBlockComment() {
+    i32 start_line = state.line;
+
+    while (true) {
+        ScanRun([](const i8 *d, u64 pos, u64 end) { return FindEither(d, pos, end, '*', '\n'); });
+
+        i8 c = state.script_pointer;
+        if (state.cursor >= length) {
+            return AddError(Lexer_Error_Incomplete_Comment, state.token_start, start_line, 0, nullptr);
+        }
+
+        Advance(1);
+        if (c == '\n') {
+            state.line++;
+        } else if (state.script_pointer == '/') {
+            Advance(1);
+            return true;
         }
     }
 }
 
-void Lexer::Error(string error) {
+void LexerConfigError(const i8 *error) {
+    Panic(string("Lexer config: ") + error);
+}
+
+// false = lexing stops here
+bool Lexer::AddError(Lexer_Error_Code code, u64 position, i32 line, i8 character, const i8 *message) {
+    u64 line_start = position;
+    while (line_start > 0 && data[line_start - 1] != '\n') {
+        line_start--;
+    }
+
+    error_count++;
+    errors.push_back({code, character, line, i32(position - line_start + 1), window_offset + position, message});
+
+    if (recover && !state.eof && errors.size() < Max_Errors) {
+        return true;
+    }
+
+    if (recover && errors.size() >= Max_Errors) {
+        errors.push_back({Lexer_Error_Too_Many_Errors, 0, line, 0, window_offset + position, nullptr});
+    }
+
+    state.ok = false;
+    if (report_errors && !recover) {
+        report("%s\n", FormatLexerError(errors.back()).c_str());
+    }
+    return false;
+}
+
+// skips to the next newline or '}', whichever comes first
+void Lexer::Resync() {
+    ScanRun([](const i8 *d, u64 pos, u64 end) { return FindEither(d, pos, end, '\n', '}'); });
+}
+
+void Lexer::Error(const i8 *message) {
     if (!state.ok) {
         return;
     }
 
-    state.ok    = false;
-    state.error = error;
-    report("%s Line: %d Current token: '%s'\n", error.c_str(), state.line, next_token.text.c_str());
+    u64 position = state.cursor;
+    if (next_token.text.data() >= data && next_token.text.data() < data + length) {
+        position = u64(next_token.text.data() - data);
+    }
+
+    if (!AddError(Lexer_Error_Parse, position, next_token.line, 0, message)) {
+        return;
+    }
+
+    // the peeked token already is on the next line or closes the block
+    if (has_lookahead) {
+        if (lookahead.line > next_token.line || lookahead.type == Token_Close_Curly_Brace || lookahead.type == Token_End) {
+            return;
+        }
+        has_lookahead = false;
+    }
+    Resync();
 }
 
-void Lexer::FromFile(const i8 *file_name) {
-    input        = StringFile(file_name);
-    state.line   = 1;
-    state.cursor = 0;
-    state.ok     = true;
-    state.eof    = false;
+void Lexer::ReportErrors() {
+    string text;
+    for (const Lexer_Error &error : errors) {
+        text += FormatLexerError(error);
+        text += "\n";
+    }
+
+    if (!text.empty()) {
+        report("%s", text.c_str());
+    }
+}
+
+string FormatLexerError(const Lexer_Error &error) {
+    string where = StringF("Line %d, column %d (offset %llu): ", error.line, error.column, (unsigned long long)error.offset);
+
+    switch (error.code) {
+        case Lexer_Error_Unknown_Token:
+            return where + StringF("unknown token '%c'", error.character);
+        case Lexer_Error_Incomplete_String:
+            return where + "incomplete string";
+        case Lexer_Error_Incomplete_Comment:
+            return where + "incomplete comment";
+        case Lexer_Error_Parse:
+            return where + (error.message ? error.message : "parse error");
+        case Lexer_Error_Too_Many_Errors:
+            return where + "too many errors, stopped";
+    }
+
+    return where + "unknown error";
+}
+
+void Lexer::Reset() {
+    has_lookahead     = false;
+    next_token        = {};
+    error_count       = 0;
+    errors.clear();
+    window_offset     = 0;
+    state.line        = 1;
+    state.cursor      = 0;
+    state.token_start = 0;
+    state.ok          = true;
+    state.eof         = false;
     Refill();
 }
 
+void Lexer::FromFile(const i8 *file_name) {
+    stream.close();
+    input.clear();
+
+    // no copy - the OS pages the file in (and reads ahead) while we lex
+    if (mapped_input.open(file_name)) {
+        data   = (const i8 *)mapped_input.data;
+        length = mapped_input.size;
+        Reset();
+        return;
+    }
+
+    // empty or unmappable file
+    FromString(StringFile(file_name));
+}
+
+void Lexer::FromFileStreaming(const i8 *file_name, u64 window_chunk_size) {
+    mapped_input.close();
+    input.clear();
+    stream.close();
+
+    stream.open(file_name, std::ios::binary);
+    if (!stream.is_open()) {
+        report("%s could not be found!\n", file_name);
+    }
+
+    chunk_size = window_chunk_size;
+    data       = input.data();
+    length     = 0;
+    Reset();
+}
+
+void Lexer::FromMemory(const i8 *memory, u64 size) {
+    mapped_input.close();
+    stream.close();
+    input.clear();
+
+    data   = memory;
+    length = size;
+    Reset();
+}
+
+void Lexer::FromString(string text) {
+    mapped_input.close();
+    stream.close();
+
+    input  = std::move(text);
+    data   = input.data();
+    length = input.size();
+    Reset();
+}
+
 void Lexer::SkipTokens(i32 n) {
     while (n > 0) {
-        Token t = GetToken();
+        Token_View t = GetTokenView();
         if (t.type == Token_End || !state.ok) {
             return;
         }
@@ -202,3 +814,356 @@ void Lexer::SkipTokens(i32 n) {
 bool Lexer::StoppedParsing() {
     return !state.ok || state.eof;
 }
+
+/*
+===============================================================================
+
+     Parallel tokenizing.
+
+     The input is cut into chunks at newlines that aren't inside a string, every
+     chunk is lexed on the worker threads by its own lexer and the token arrays
+     are glued together with the line numbers shifted.
+
+     Finding the cuts needs the quote parity at the cut. Pass one counts the
+     quotes of equally sized regions in parallel, a prefix xor over the region
+     counts gives the parity at every region start, and the cut is the first
+     newline outside a string from there.
+
+     Quotes inside comments fool the parity, so the cuts are only a guess: a
+     chunk that lexes without an error to its very end leaves the lexer in the
+     same state as the sequential lexer at the cut (the cut follows a newline,
+     no token or comment can span it). If any chunk fails everything is lexed
+     again sequentially, which also reports the error where it really is. A
+     '\0' ends the input like it does for the sequential lexer, nothing from
+     the chunks behind the one that hit it is used.
+
+===============================================================================
+*/
+
+namespace {
+struct Quote_Region {
+    const i8 *data;
+    u64       begin;
+    u64       end;
+    u64       quotes;
+};
+
+struct Lex_Chunk {
+    std::string_view     text;
+    const Lexer_Config * config;
+    Array_Of<Token_View> tokens;
+    i32                  lines; // newlines seen by the chunk's lexer
+    bool                 ok;
+    bool                 ended_early; // Token_End before the end of the chunk, an embedded '\0'
+};
+
+void CountQuotesTask(void *data) {
+    Quote_Region *region = (Quote_Region *)data;
+    region->quotes       = CountQuotes(region->data, region->begin, region->end);
+}
+
+void LexChunkTask(void *data) {
+    Lex_Chunk *chunk = (Lex_Chunk *)data;
+    Lexer      lexer;
+
+    lexer.config        = chunk->config;
+    lexer.report_errors = false;
+    lexer.FromMemory(chunk->text.data(), chunk->text.size());
+
+    chunk->tokens.reserve(chunk->text.size() / 8);
+    while (true) {
+        Token_View token = lexer.GetTokenView();
+        if (!lexer.state.ok) {
+            break;
+        }
+        if (token.type == Token_End) {
+            chunk->ended_early = lexer.state.token_start < chunk->text.size();
+            break;
+        }
+        chunk->tokens.push_back(token);
+    }
+
+    chunk->ok    = lexer.state.ok;
+    chunk->lines = lexer.state.line - 1;
+}
+} // namespace
+
+// per call, not per token, the scanning loops stay untouched
+static const Metric_Id lexer_bytes_metric     = metric_counter("lexer_bytes");
+static const Metric_Id lexer_tokens_metric    = metric_counter("lexer_tokens");
+static const Metric_Id lexer_fallbacks_metric = metric_counter("lexer_parallel_fallbacks");
+
+bool TokenizeSequential(std::string_view text, Array_Of<Token_View> &tokens, const Lexer_Config *config) {
+    Lexer lexer;
+    lexer.config = config;
+    lexer.FromMemory(text.data(), text.size());
+
+    tokens.clear();
+    while (lexer.state.ok) {
+        tokens.push_back(lexer.GetTokenView());
+        if (tokens.back().type == Token_End) {
+            break;
+        }
+    }
+
+    metric_add(lexer_bytes_metric, text.size());
+    metric_add(lexer_tokens_metric, tokens.size());
+    return lexer.state.ok;
+}
+
+bool TokenizeParallel(std::string_view text, Array_Of<Token_View> &tokens, const Lexer_Config *config, u64 min_chunk_size) {
+    u64 max_chunks  = u64(std::thread::hardware_concurrency()) * 4;
+    u64 chunk_count = text.size() / (min_chunk_size ? min_chunk_size : 1);
+    chunk_count     = (chunk_count < max_chunks) ? chunk_count : max_chunks;
+
+    // nobody to hand the chunks to before worker.init()
+    if (chunk_count <= 1 || !worker.is_running()) {
+        return TokenizeSequential(text, tokens, config);
+    }
+
+    u64                    region_size = text.size() / chunk_count;
+    Array_Of<Quote_Region> regions(chunk_count);
+
+    for (u64 i = 0; i < chunk_count; i++) {
+        regions[i] = {text.data(), i * region_size, (i + 1 == chunk_count) ? text.size() : (i + 1) * region_size, 0};
+        worker.submit(&regions[i], CountQuotesTask);
+    }
+    worker.wait();
+
+    Array_Of<Lex_Chunk> chunks;
+    chunks.reserve(chunk_count);
+
+    u64  chunk_start = 0;
+    bool in_string   = false;
+    for (u64 i = 1; i <= chunk_count; i++) {
+        in_string ^= (regions[i - 1].quotes & 1) != 0;
+
+        u64 cut = text.size();
+        if (i < chunk_count) {
+            cut = FindLineStartOutsideQuotes(text.data(), regions[i].begin, text.size(), in_string);
+        }
+        if (cut <= chunk_start) {
+            continue;
+        }
+
+        chunks.push_back({text.substr(chunk_start, cut - chunk_start), config, {}, 0, false, false});
+        chunk_start = cut;
+    }
+
+    for (Lex_Chunk &chunk : chunks) {
+        worker.submit(&chunk, LexChunkTask);
+    }
+    worker.wait();
+
+    // the sequential lexer stops at the first '\0', so does the merge
+    u64 used_chunks = 0;
+    u64 token_count = 1;
+    for (Lex_Chunk &chunk : chunks) {
+        if (!chunk.ok) {
+            metric_add(lexer_fallbacks_metric);
+            return TokenizeSequential(text, tokens, config);
+        }
+        token_count += chunk.tokens.size();
+        used_chunks++;
+        if (chunk.ended_early) {
+            break;
+        }
+    }
+
+    tokens.clear();
+    tokens.reserve(token_count);
+
+    i32 line_offset = 0;
+    for (u64 i = 0; i < used_chunks; i++) {
+        Lex_Chunk &chunk = chunks[i];
+        for (Token_View &token : chunk.tokens) {
+            token.line += line_offset;
+            tokens.push_back(token);
+        }
+        line_offset += chunk.lines;
+    }
+
+    Token_View end = {};
+    end.type       = Token_End;
+    end.line       = line_offset + 1;
+    tokens.push_back(end);
+
+    metric_add(lexer_bytes_metric, text.size());
+    metric_add(lexer_tokens_metric, tokens.size());
+    return true;
+}
+
+/*
+===============================================================================
+
+     Self test.
+
+     Random but well formed input with no newline at the end, so the last
+     run ends exactly at the end of the input. The streaming window is cut
+     at every chunk size from a single byte up and has to hand out exactly
+     the tokens of lexing the whole text at once.
+
+     The SSE scanners are run against their scalar versions over random
+     bytes, from every start to every end position, so runs cross 16 byte
+     blocks and end at the end of the input at every offset.
+
+===============================================================================
+*/
+
+namespace {
+string SelfTestInput(i32 token_count) {
+    static const char *words[] = {"a", "config", "value_1", "x.y.z", "under_score", "abcdefghijklmnopqrstuvwxyz0123456789"};
+    static const char *marks   = "{}=[](),;:";
+    string             out;
+
+    for (i32 i = 0; i < token_count; i++) {
+        switch (RandomI32(6)) {
+            case 0:
+                out += words[RandomI32(6)];
+                break;
+            case 1:
+                out += StringF("%d", RandomI32(2000000) - 1000000);
+                break;
+            case 2:
+                out += StringF("%.3fe%d", f64(RandomF32()) * 100.0, RandomI32(20) - 10);
+                break;
+            case 3:
+                out += StringF("0x%X", RandomI32(0x7fffffff));
+                break;
+            case 4:
+                out += StringF("\"s%d %d\"", RandomI32(1000), RandomI32(1000));
+                break;
+            default:
+                out += marks[RandomI32(10)];
+                break;
+        }
+
+        // runs of every length, so some of them cross a 16 byte block or a window chunk
+        i32 spaces = RandomI32(4) == 0 ? 1 + RandomI32(40) : 1;
+        for (i32 s = 0; s < spaces && i + 1 < token_count; s++) {
+            out += " \t\n"[RandomI32(3)];
+        }
+    }
+
+    return out;
+}
+
+#if LEXER_SIMD
+// bytes on both sides of every range the SSE loops compare against, and bytes above 0x7f
+string ScannerTestInput(u64 length) {
+    static const char alphabet[] = "azAZ09._ \t\r\n\"}{/:@[`\x7f\x80\xff-#";
+    string            out;
+
+    // a run of one class, so the runs are long enough to cross 16 byte blocks
+    std::string_view run = (RandomI32(2) == 0) ? "q7_." : (RandomI32(2) == 0) ? "0123456789" : " \t\n\r";
+
+    for (u64 i = 0; i < length; i++) {
+        if (RandomI32(8) == 0) {
+            out += alphabet[RandomI32(i32(sizeof(alphabet)) - 1)];
+        } else if (RandomI32(16) == 0) {
+            out += '\0';
+        } else {
+            out += run[RandomI32(i32(run.size()))];
+        }
+    }
+
+    return out;
+}
+
+// every SSE loop against its scalar version, from every start to every end position
+bool ScannersMatch(const string &text) {
+    const i8 *data   = text.data();
+    u64       length = text.size();
+
+    for (u64 pos = 0; pos <= length; pos++) {
+        for (u64 end = pos; end <= length; end++) {
+            i32  newlines        = 0;
+            i32  scalar_newlines = 0;
+            bool same            = true;
+
+            same = same && SkipIdentifier(data, pos, end) == SkipClassScalar(data, pos, end, Char_Identifier);
+            same = same && SkipDigits(data, pos, end) == SkipClassScalar(data, pos, end, Char_Digit);
+            same = same && SkipSpaces(data, pos, end, newlines) == SkipSpacesScalar(data, pos, end, scalar_newlines);
+            same = same && newlines == scalar_newlines;
+            same = same && FindEither(data, pos, end, '\n', '\0') == FindEitherScalar(data, pos, end, '\n', '\0');
+            same = same && FindEither(data, pos, end, '\n', '}') == FindEitherScalar(data, pos, end, '\n', '}');
+            same = same && CountQuotes(data, pos, end) == CountQuotesScalar(data, pos, end);
+            same = same && FindLineStartOutsideQuotes(data, pos, end, false) == FindLineStartOutsideQuotesScalar(data, pos, end, false);
+            same = same && FindLineStartOutsideQuotes(data, pos, end, true) == FindLineStartOutsideQuotesScalar(data, pos, end, true);
+
+            if (!same) {
+                report("LexerSelfTest: the SSE and the scalar scanners differ between %llu and %llu of a %llu byte input\n",
+                       (unsigned long long)pos, (unsigned long long)end, (unsigned long long)length);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+#endif
+
+bool SameToken(const Token_View &a, const Token_View &b) {
+    return a.type == b.type && a.text == b.text && a.line == b.line && a.int_value == b.int_value && a.dbl_value == b.dbl_value;
+}
+
+bool StreamingMatches(const string &text, const string &file_name) {
+    FILE *file = fopen(file_name.c_str(), "wb");
+    if (!file) {
+        report("LexerSelfTest: can't write %s\n", file_name.c_str());
+        return false;
+    }
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    Array_Of<Token_View> expected;
+    TokenizeSequential(text, expected);
+
+    for (u64 chunk_size : {1, 2, 3, 5, 16, 17, 64}) {
+        Lexer lexer;
+        lexer.FromFileStreaming(file_name.c_str(), chunk_size);
+
+        for (u64 i = 0; i < expected.size(); i++) {
+            Token_View token = lexer.GetTokenView();
+
+            if (!SameToken(token, expected[i])) {
+                report("LexerSelfTest: %llu byte chunks, token %llu is '%.*s', expected '%.*s'\n", (unsigned long long)chunk_size,
+                       (unsigned long long)i, i32(token.text.size()), token.text.data(), i32(expected[i].text.size()),
+                       expected[i].text.data());
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+} // namespace
+
+bool LexerSelfTest(u32 seed) {
+    string file_name = (std::filesystem::temp_directory_path() / StringF("lexer_self_test_%u.txt", seed)).string();
+    bool   ok        = true;
+
+    RandomSeed(seed);
+
+#if LEXER_SIMD
+    // runs ending at, before and after a 16 byte boundary and at the end of the input
+    for (u64 length = 0; length <= 70 && ok; length++) {
+        ok = ScannersMatch(string(length, 'a')) && ScannersMatch(string(length, '7')) && ScannersMatch(string(length, '\n'));
+    }
+    for (i32 i = 0; i < 200 && ok; i++) {
+        ok = ScannersMatch(ScannerTestInput(u64(RandomI32(100))));
+    }
+#endif
+
+    // a run cut off by the end of the file in the middle of a window
+    for (const char *text : {"abcd efgh 12345", "abcd efgh ijklm", "1 2.5e10", "x \"str\"", "a\n\n\n  \t"}) {
+        ok = ok && StreamingMatches(text, file_name);
+    }
+    for (i32 i = 0; i < 50 && ok; i++) {
+        ok = StreamingMatches(SelfTestInput(1 + RandomI32(200)), file_name);
+    }
+
+    std::error_code error;
+    std::filesystem::remove(file_name, error);
+    return ok;
+}
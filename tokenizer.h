@@ -2,10 +2,13 @@
 #define TOKENIZER_H
 
 #include <string>
+#include <string_view>
+#include <initializer_list>
 #include <sstream>
 #include <fstream>
 
 #include "typedefs.h"
+#include "util.h"
 
 enum Token_Type {
     Token_Unknown = 0,
@@ -18,7 +21,15 @@ enum Token_Type {
     Token_Identifier,
     Token_Open_Curly_Brace,
     Token_Close_Curly_Brace,
-    Token_Equal
+    Token_Equal,
+    Token_Open_Bracket,
+    Token_Close_Bracket,
+    Token_Open_Paren,
+    Token_Close_Paren,
+    Token_Comma,
+    Token_Semicolon,
+    Token_Colon,
+    Token_Keyword,
 };
 
 struct Token {
@@ -26,38 +37,332 @@ struct Token {
     string     text;
     f32        fl_value;
     i32        int_value;
+    f64        dbl_value;
+    i32        keyword; // index into the lexer config's keyword list for Token_Keyword
 
     bool Identifier_Match(const string &t) {
         return (type == Token_Identifier && text == t);
     }
 };
 
+//
+// A token that points into the lexer's input instead of owning its text. String
+// tokens don't include the quotes. Number tokens come with their value converted
+// (int_value is clamped to the i32 range, floats are truncated towards zero).
+//
+struct Token_View {
+    Token_Type       type;
+    std::string_view text;
+    f32              fl_value;
+    i32              int_value;
+    f64              dbl_value;
+    i32              keyword;
+    i32              line;
+
+    bool Identifier_Match(std::string_view t) const {
+        return (type == Token_Identifier && text == t);
+    }
+
+    Token ToToken() const {
+        return Token{type, string(text), fl_value, int_value, dbl_value, keyword};
+    }
+};
+
+/*
+===============================================================================
+
+     Lexer configuration.
+
+     Everything the lexer needs to know about a file format is baked into
+     tables at compile time: what every byte starts (punctuation, comment,
+     string, number, ...), which comment styles exist and a perfect hashed
+     keyword set. ScanToken does one table lookup per token instead of a
+     switch over hard coded characters, so one loop serves every format.
+
+     Identifier, number and string syntax is fixed - the SIMD scanning loops
+     depend on it.
+
+         constexpr Lexer_Config script_config(Comment_Double_Slash | Comment_Block, "{}()[];,=",
+                                              {"if", "else", "while", "return"});
+
+===============================================================================
+*/
+
+enum Comment_Style : u32 {
+    Comment_None         = 0,
+    Comment_Hash         = 1, // # until the end of the line
+    Comment_Double_Slash = 2, // // until the end of the line
+    Comment_Block        = 4, // /* ... */, not nested
+};
+
+// not constexpr on purpose - calling it while building a config turns the mistake into a compile error
+void LexerConfigError(const i8 *error);
+
+constexpr Token_Type PunctuationType(i8 c) {
+    constexpr std::string_view chars   = "/#{}=[](),;:";
+    constexpr Token_Type       types[] = {Token_Forward_Slash, Token_Hash,         Token_Open_Curly_Brace, Token_Close_Curly_Brace,
+                                          Token_Equal,         Token_Open_Bracket, Token_Close_Bracket,    Token_Open_Paren,
+                                          Token_Close_Paren,   Token_Comma,        Token_Semicolon,        Token_Colon};
+
+    u64 index = chars.find(c);
+    return (index == std::string_view::npos) ? Token_Unknown : types[index];
+}
+
+//
+// The seed is searched at compile time until every keyword lands in its own slot, a
+// lookup is one hash and at most one string compare.
+//
+struct Lexer_Keyword_Set {
+    static constexpr u32 Max_Keywords = 32;
+    static constexpr u32 Table_Size   = 4 * Max_Keywords;
+
+    std::string_view words[Table_Size] = {};
+    i32              ids[Table_Size]   = {};
+    u32              seed              = 0;
+    u32              count             = 0;
+    u32              mask              = 0;
+    u32              min_length        = ~0u;
+    u32              max_length        = 0;
+
+    static constexpr u32 Hash(std::string_view word, u32 seed) {
+        u32 hash = 2166136261u ^ seed;
+        for (i8 c : word) {
+            hash = (hash ^ u8(c)) * 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+
+    constexpr Lexer_Keyword_Set() = default;
+
+    constexpr Lexer_Keyword_Set(std::initializer_list<std::string_view> keywords) {
+        count = u32(keywords.size());
+        if (count > Max_Keywords) {
+            LexerConfigError("too many keywords");
+        }
+
+        u32 size = 1;
+        while (size < 4 * count) {
+            size *= 2;
+        }
+        mask = size - 1;
+
+        for (const std::string_view *word = keywords.begin(); word != keywords.end(); word++) {
+            min_length = (u32(word->size()) < min_length) ? u32(word->size()) : min_length;
+            max_length = (u32(word->size()) > max_length) ? u32(word->size()) : max_length;
+
+            for (const std::string_view *other = keywords.begin(); other != word; other++) {
+                if (*other == *word) {
+                    LexerConfigError("duplicate keyword");
+                }
+            }
+        }
+
+        for (seed = 1; seed < 0x1000; seed++) {
+            for (u32 i = 0; i <= mask; i++) {
+                words[i] = {};
+                ids[i]   = -1;
+            }
+
+            bool collision = false;
+            i32  id        = 0;
+            for (std::string_view word : keywords) {
+                u32 slot = Hash(word, seed) & mask;
+                if (ids[slot] != -1) {
+                    collision = true;
+                    break;
+                }
+                words[slot] = word;
+                ids[slot]   = id++;
+            }
+
+            if (!collision) {
+                return;
+            }
+        }
+
+        LexerConfigError("no perfect hash for the keyword set");
+    }
+
+    // keyword id, -1 if 'word' isn't a keyword
+    constexpr i32 Find(std::string_view word) const {
+        if (count == 0 || word.size() < min_length || word.size() > max_length) {
+            return -1;
+        }
+
+        u32 slot = Hash(word, seed) & mask;
+        return (ids[slot] >= 0 && words[slot] == word) ? ids[slot] : -1;
+    }
+};
+
+struct Lexer_Config {
+    // what a byte starts when it's the first character of a token
+    enum Char_Action : u8 {
+        Action_Unknown = 0,
+        Action_End,
+        Action_Space,
+        Action_Punctuation,
+        Action_Slash, // comment or punctuation, depends on the next character
+        Action_Line_Comment,
+        Action_String,
+        Action_Number,
+        Action_Identifier,
+    };
+
+    u8                actions[256]     = {};
+    u8                punctuation[256] = {}; // Token_Type of single character tokens
+    u32               comments         = Comment_None;
+    Lexer_Keyword_Set keywords;
+
+    constexpr Lexer_Config(u32 comment_styles, std::string_view punctuation_chars, Lexer_Keyword_Set keyword_set = {})
+        : comments(comment_styles), keywords(keyword_set) {
+        for (i32 c = 'a'; c <= 'z'; c++) {
+            actions[c]             = Action_Identifier;
+            actions[c - 'a' + 'A'] = Action_Identifier;
+        }
+        for (i32 c = '0'; c <= '9'; c++) {
+            actions[c] = Action_Number;
+        }
+        actions[u8('-')]  = Action_Number;
+        actions[u8('"')]  = Action_String;
+        actions[u8(' ')]  = Action_Space;
+        actions[u8('\t')] = Action_Space;
+        actions[u8('\r')] = Action_Space;
+        actions[u8('\n')] = Action_Space;
+        actions[0]        = Action_End;
+
+        for (i8 c : punctuation_chars) {
+            if (PunctuationType(c) == Token_Unknown || actions[u8(c)] != Action_Unknown) {
+                LexerConfigError("character can't be punctuation");
+            }
+            actions[u8(c)]     = Action_Punctuation;
+            punctuation[u8(c)] = u8(PunctuationType(c));
+        }
+
+        if (comments & Comment_Hash) {
+            actions[u8('#')] = Action_Line_Comment;
+        }
+        if (comments & (Comment_Double_Slash | Comment_Block)) {
+            actions[u8('/')] = Action_Slash;
+        }
+    }
+};
+
+// # comments, no keywords - what the config files use
+inline constexpr Lexer_Config default_lexer_config(Comment_Hash, "/{}=[](),;:");
+
+enum Lexer_Error_Code : u8 {
+    Lexer_Error_Unknown_Token,
+    Lexer_Error_Incomplete_String,
+    Lexer_Error_Incomplete_Comment,
+    Lexer_Error_Parse, // reported by the parser through Lexer::Error
+    Lexer_Error_Too_Many_Errors,
+};
+
+//
+// Errors are recorded, not printed - nothing is formatted until somebody asks with
+// FormatLexerError / Lexer::ReportErrors.
+//
+struct Lexer_Error {
+    Lexer_Error_Code code;
+    i8               character; // the offending character for Lexer_Error_Unknown_Token
+    i32              line;
+    i32              column;  // 1 based, counted from the start of the streaming window if the line started before it
+    u64              offset;  // byte offset in the input
+    const i8 *       message; // Lexer_Error_Parse only, has to be a string literal
+};
+
+string FormatLexerError(const Lexer_Error &error);
+
+//
+// Input sources:
+//     FromString        - lexes the string
+//     FromMemory        - lexes the caller's buffer in place, it has to outlive the tokens
+//     FromFile          - maps the file, token views stay valid as long as the lexer lives
+//     FromFileStreaming - reads the file in 'chunk_size' pieces into a window that only
+//                         keeps the token being scanned, memory use doesn't depend on the file
+//                         size. A Token_View is only valid until the next Get*/Peek* call.
+//
+// Errors:
+//     By default the first error stops the lexer (state.ok = false) and is reported if
+//     'report_errors' is set. With 'recover' set the lexer records the error, skips to the
+//     next newline or '}' and carries on, the caller looks at 'errors' when it's done.
+//
 struct Lexer {
+    static constexpr u64 Max_Errors = 256;
+
     struct Tokenizer_State {
-        bool   ok;
-        bool   eof;
-        i8     script_pointer;
-        i32    line;
-        u64    cursor;
-        string error;
+        bool ok;
+        bool eof;
+        i8   script_pointer;
+        i32  line;
+        u64  cursor;      // relative to 'data'
+        u64  token_start; // start of the token being scanned, relative to 'data'
     } state;
 
-    string input;
-    Token  next_token;
-    bool   IsAlpha(i8 c);
-    bool   IsNumber(i8 c);
-    void   Refill();
-    string Forward(int count);
-
-    void   Error(string error);
-    Token  PeekToken();
-    bool   ExpectToken(Token &t, Token_Type expected);
-    bool   ExpectIdentifier(Token &t, const string &text);
-    Token  GetToken();
-    string ConsumeLine();
-    void   FromFile(const i8 *file_name);
-    void   SkipTokens(i32 n);
-    bool   StoppedParsing();
+    string        input; // FromString text or the streaming window
+    Mapped_File   mapped_input;
+    std::ifstream stream;
+    u64           chunk_size = 64 * 1024;
+    const i8 *    data       = nullptr;
+    u64           length     = 0;
+    u64           window_offset; // byte offset of data[0] in the file
+
+    const Lexer_Config *  config        = &default_lexer_config;
+    bool                  report_errors = true;
+    bool                  recover       = false;
+    Array_Of<Lexer_Error> errors;          // the first Max_Errors errors
+    u64                   error_count = 0; // all of them
+
+    Token_View next_token;    // the last token handed out by Get*
+    Token_View lookahead;     // scanned by Peek*, not handed out yet
+    bool       has_lookahead;
+    bool       IsAlpha(i8 c);
+    bool       IsNumber(i8 c);
+    void       Refill();
+    bool       FillWindow();
+    void       Advance(u64 count);
+    void       Seek(u64 cursor);
+    i8         PeekChar(u64 ahead);
+    void       ScanNumber(Token_View &token);
+    bool       ScanBlockComment();
+    bool       AddError(Lexer_Error_Code code, u64 position, i32 line, i8 character, const i8 *message);
+    void       Resync();
+    void       Reset();
+    Token_View ScanToken();
+
+    template <typename Skip_Fun>
+    void ScanRun(Skip_Fun skip);
+
+    void              Error(const i8 *message);
+    void              ReportErrors();
+    Token             PeekToken();
+    const Token_View &PeekTokenView();
+    bool              ExpectToken(Token &t, Token_Type expected);
+    bool              ExpectToken(Token_View &t, Token_Type expected);
+    bool              ExpectIdentifier(Token &t, const string &text);
+    Token             GetToken();
+    Token_View        GetTokenView();
+    std::string_view  ConsumeLine();
+    void              FromFile(const i8 *file_name);
+    void              FromFileStreaming(const i8 *file_name, u64 window_chunk_size = 64 * 1024);
+    void              FromMemory(const i8 *memory, u64 size);
+    void              FromString(string text);
+    void              SkipTokens(i32 n);
+    bool              StoppedParsing();
 };
 
+//
+// Lex a whole buffer into 'tokens', the last one is Token_End unless there was an error.
+// The views point into 'text'. TokenizeParallel splits inputs bigger than 'min_chunk_size'
+// over the worker threads and returns exactly what TokenizeSequential would. Before
+// worker.init() (or after the worker shut down) it just is TokenizeSequential.
+//
+bool TokenizeSequential(std::string_view text, Array_Of<Token_View> &tokens, const Lexer_Config *config = &default_lexer_config);
+bool TokenizeParallel(std::string_view text, Array_Of<Token_View> &tokens, const Lexer_Config *config = &default_lexer_config,
+                      u64 min_chunk_size = 256 * 1024);
+
+// lexes random input every way there is (streaming at every chunk size, ...) and checks that
+// they all agree, reports the first difference. Writes a scratch file to the temp directory.
+bool LexerSelfTest(u32 seed);
+
 #endif
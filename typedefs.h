@@ -7,6 +7,7 @@
 #include <map>
 #include <string>
 #include "nmmintrin.h" // for SSE4.2
+#include "platform.h"
 
 union sse_f32x4 {
     __m128 a4;
@@ -38,11 +39,11 @@ class Aligned_Allocator {
         constexpr auto item_size  = sizeof(value_type);
         const auto     total_size = n * item_size;
 
-        return static_cast<value_type *>(_aligned_malloc(total_size, alignof(T)));
+        return static_cast<value_type *>(platform_aligned_alloc(total_size, alignof(T)));
     }
 
     void deallocate(value_type *p, std::size_t) noexcept {
-        _aligned_free(p);
+        platform_aligned_free(p);
     }
 };
 
@@ -1,10 +1,12 @@
 #include "util.h"
 #include "timer.h"
-#include "windows.h"
+#include "stringfmt.h"
+#include "async_log.h"
+#include "platform.h"
 
 #include <assert.h>
 #include <fcntl.h>
-#include <io.h>
+#include <stdarg.h>
 #include <mutex>
 #include <random>
 #include <string>
@@ -14,13 +16,23 @@
 #include <locale>
 #include <codecvt>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // static FILE *         g_logFile             = fopen("_debug.txt", "w");
 thread_local uint32_t random_state = 1234;
 static High_Res_Timer timer;
 static bool           already_panicked = false;
 static std::mutex     g_reportMutex;
 static std::string    g_debug_string_buffer = "init";
+#ifdef _WIN32
 static HWND           con_handle            = 0;
+#endif
 
 inline uint32_t xorshift32() {
     random_state ^= random_state << 13;
@@ -30,21 +42,49 @@ inline uint32_t xorshift32() {
     return random_state;
 }
 
+#ifdef _WIN32
 void SetConsoleHistoryWndHandle(HWND con) {
     con_handle = con;
 }
+#endif
 
-void report(const char *format, ...) {
+void ReportOutput(const char *text, u64 length) {
     std::lock_guard<std::mutex> theLock(g_reportMutex);
 
-    static char *string_buffer          = NULL;
-    static i32   string_buffer_capacity = 0;
-    static bool  debugger_present       = !!IsDebuggerPresent();
-    int          new_len;
+    platform_debug_output(text);
+
+#ifdef _WIN32
+    static std::string tmp;
+
+    if (con_handle) {
+        tmp.clear();
+        for (u64 i = 0; i < length; i++) {
+            if (text[i] == '\n') {
+                tmp += '\r';
+            }
+            tmp += text[i];
+        }
+
+        SendMessageA(con_handle, EM_SETSEL, 0, -1);
+        SendMessageA(con_handle, EM_SETSEL, -1, -1);
+        SendMessageA(con_handle, EM_LINESCROLL, 0, 0xffff);
+        SendMessageA(con_handle, EM_SCROLLCARET, 0, 0);
+        SendMessageA(con_handle, EM_REPLACESEL, 0, (LPARAM)tmp.c_str());
+    }
+#else
+    // only the Windows console needs the length, the debug output takes the terminated text
+    (void)length;
+#endif
+}
+
+void report(const char *format, ...) {
+    thread_local char *string_buffer          = NULL;
+    thread_local i32   string_buffer_capacity = 0;
+    int                new_len;
 
     va_list args1;
     va_start(args1, format);
-    new_len = _vscprintf(format, args1) + 1;
+    new_len = vsnprintf(NULL, 0, format, args1) + 1;
     va_end(args1);
 
     if (new_len > string_buffer_capacity) {
@@ -53,34 +93,13 @@ void report(const char *format, ...) {
     }
 
     va_start(args1, format);
-    vsprintf_s(string_buffer, new_len, format, args1);
+    vsnprintf(string_buffer, new_len, format, args1);
     va_end(args1);
 
-    if (debugger_present) {
-        OutputDebugStringA(string_buffer);
-    }
-
-    std::string tmp;
-    char *      p = string_buffer;
-    while (*p) {
-        if (*p == '\n') {
-            tmp += "\r\n";
-        } else {
-            tmp += *p;
-        }
-        p++;
-    }
-
-    if (con_handle) {
-        SendMessageA(con_handle, EM_SETSEL, 0, -1);
-        SendMessageA(con_handle, EM_SETSEL, -1, -1);
-        SendMessageA(con_handle, EM_LINESCROLL, 0, 0xffff);
-        SendMessageA(con_handle, EM_SCROLLCARET, 0, 0);
-        SendMessageA(con_handle, EM_REPLACESEL, 0, (LPARAM)tmp.c_str());
+    // the writer thread hands it to ReportOutput, until the async log runs it's written right here
+    if (!async_log_write(string_buffer, new_len - 1)) {
+        ReportOutput(string_buffer, new_len - 1);
     }
-
-    // fprintf_s(g_logFile, "%s", stringBuffer.c_str());
-    // fflush(g_logFile);
 }
 
 String_Array VectorFile(const char *file_name) {
@@ -124,6 +143,95 @@ std::string StringFile(const char *file_name) {
 #endif
 }
 
+#ifdef _WIN32
+bool Mapped_File::open(const char *file_name) {
+    close();
+
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        // can't map an empty file
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+
+    data           = (const u8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    size           = u64(file_size.QuadPart);
+    file_handle    = file;
+    mapping_handle = mapping;
+
+    if (data == NULL) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void Mapped_File::close() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        CloseHandle(file_handle);
+    }
+
+    data           = nullptr;
+    size           = 0;
+    file_handle    = nullptr;
+    mapping_handle = nullptr;
+}
+#else
+bool Mapped_File::open(const char *file_name) {
+    close();
+
+    int fd = ::open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        // can't map an empty file
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) {
+        return false;
+    }
+
+    data = (const u8 *)p;
+    size = u64(st.st_size);
+    return true;
+}
+
+void Mapped_File::close() {
+    if (data) {
+        munmap((void *)data, size_t(size));
+    }
+
+    data = nullptr;
+    size = 0;
+}
+#endif
+
 void SplitString(const std::string &str, String_Array *out, char delim) {
     std::stringstream ss(str);
     std::string       token;
@@ -159,11 +267,11 @@ f32 StrToF32(const std::string &string, f32 default_value) {
 }
 
 f64 GetTimeMicro() {
-    return timer.GetTimeMicro();
+    return timer.get_time_micro();
 }
 
 f64 GetTimeMs() {
-    return timer.GetTimeMs();
+    return timer.get_time_ms();
 }
 
 i32 RandomI32(i32 upper_bound) {
@@ -192,7 +300,7 @@ vec3 RandomUnitInDisc() {
     vec3 p;
     do {
         p = 2.0f * vec3{RandomF32(), RandomF32(), 0.0f} - vec3{1.0f, 1.0f, 0.0f};
-    } while (Vec3Dot(p, p) >= 1.0f);
+    } while (vec3_dot(p, p) >= 1.0f);
 
     return p;
 }
@@ -222,13 +330,14 @@ vec3 rgb2vec3(i32 r, i32 g, i32 b, f32 intensity) {
 }
 
 std::string StringF(const char *format, ...) {
-    static char *string_buffer          = NULL;
-    static i32   string_buffer_capacity = 0;
-    int          new_len;
+    // per thread, worker tasks call this too
+    thread_local char *string_buffer          = NULL;
+    thread_local i32   string_buffer_capacity = 0;
+    int                new_len;
 
     va_list args1;
     va_start(args1, format);
-    new_len = _vscprintf(format, args1) + 1;
+    new_len = vsnprintf(NULL, 0, format, args1) + 1;
     va_end(args1);
 
     if (new_len > string_buffer_capacity) {
@@ -237,7 +346,7 @@ std::string StringF(const char *format, ...) {
     }
 
     va_start(args1, format);
-    vsprintf_s(string_buffer, new_len, format, args1);
+    vsnprintf(string_buffer, new_len, format, args1);
     va_end(args1);
 
     return string_buffer;
@@ -255,10 +364,12 @@ void TakeScreenshot(const char *file_name, Array_Of<u8> &color_buffer, i32 w, i3
     text_file.open(file_name);
 
     report("writing %s ...\n", file_name);
-    std::string temp_str = StringF("P3\n%d %d\n255\n", w, h);
+    std::string temp_str;
+    temp_str.reserve(16 + color_buffer.size() / 3 * 12);
+    format_append(temp_str, "P3\n/% /%\n255\n", w, h);
     for (i32 i = 0; i < color_buffer.size(); i += 3) {
         // RGB(normal humans) <-> BGR(Win32)
-        temp_str += StringF("%d %d %d\n", color_buffer[i + 2], color_buffer[i + 1], color_buffer[i]);
+        format_append(temp_str, "/% /% /%\n", color_buffer[i + 2], color_buffer[i + 1], color_buffer[i]);
     }
 
     text_file << temp_str;
@@ -272,8 +383,9 @@ void Panic(string panic_string) {
 
     already_panicked = true;
     report("\n\n****** Panic! ******\n\n%s\n", panic_string.c_str());
-    MessageBoxA(0, panic_string.c_str(), "System failure", MB_OK + MB_ICONERROR);
-    ExitProcess(0);
+    async_log_flush();
+    platform_error_box("System failure", panic_string.c_str());
+    platform_exit(0);
 }
 
 void RunTestCode() {
@@ -5,6 +5,7 @@
 
 #include "vec.h"
 #include "typedefs.h"
+#include "log_level.h"
 
 // from
 // https://handmade.network/forums/t/2011-keyboard_inputs_-_scancodes,_raw_input,_text_input,_key_names
@@ -194,7 +195,27 @@ enum Scancode {
 
 #define map_range(x, A, B, C, D) (((x - A) / (B - A)) * (D - C))
 
+// read only view of a whole file, the pages are loaded on demand by the OS
+struct Mapped_File {
+    const u8 *data           = nullptr;
+    u64       size           = 0;
+    void *    file_handle    = nullptr;
+    void *    mapping_handle = nullptr;
+
+    Mapped_File() = default;
+    Mapped_File(const Mapped_File &) = delete;
+    Mapped_File &operator=(const Mapped_File &) = delete;
+
+    bool open(const char *file_name);
+    void close();
+
+    ~Mapped_File() {
+        close();
+    }
+};
+
 void         report(const char *format, ...);
+void         ReportOutput(const char *text, u64 length); // debugger and console window, no formatting
 String_Array VectorFile(const char *file_name);
 std::string  StringFile(const char *file_name);
 void         SplitString(const std::string &str, String_Array *out, char delim = ' ');
@@ -215,7 +236,9 @@ std::wstring StringToWstring(const std::string &string);
 void         TakeScreenshot(const char *file_name, Array_Of<u8> &color_buffer, i32 w, i32 h);
 void         Panic(string panic_string);
 void         RunTestCode();
+#ifdef _WIN32
 void         SetConsoleHistoryWndHandle(HWND con);
+#endif
 
 template <typename Type>
 void ArrayPatternFill(Array_Of<Type> &array, i32 n, Array_Of<Type> pattern) {